@@ -0,0 +1,140 @@
+#include <mb/ai-scheduler.h>
+
+#include <mb/components.h>
+#include <mb/frame-arena.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
+
+namespace {
+
+struct Ai_tier {
+    float max_distance;
+    float interval; // seconds between thoughts, 0 for every tick
+};
+
+// Near armies can see the player or will soon; they react every tick.
+constexpr std::array<Ai_tier, 3> ai_tiers{{
+    {.max_distance = 20, .interval = 0},
+    {.max_distance = 60, .interval = 0.25F},
+    {.max_distance = std::numeric_limits<float>::infinity(), .interval = 1},
+}};
+
+float interval_at(float distance)
+{
+    return std::ranges::find_if(ai_tiers, [&](Ai_tier const &tier) {
+               return distance <= tier.max_distance;
+           })->interval;
+}
+
+// Where in its first interval an army starts, so that armies spawned together
+// don't all think on the same frame.
+double phase_of(entt::entity e)
+{
+    auto hash = static_cast<std::uint32_t>(e) * 0x9E3779B9U;
+    return static_cast<double>(hash) / 4294967296.0;
+}
+
+} // namespace
+
+Ai_scheduler::Ai_scheduler(std::chrono::microseconds budget) : budget_{budget}
+{
+}
+
+void Ai_scheduler::track(entt::registry & /*reg*/, entt::entity e)
+{
+    auto first = ai_tiers.back().interval * phase_of(e);
+    turns_.push_back(Turn{.due = now_ + first, .last = now_, .e = e});
+    std::ranges::push_heap(turns_, std::greater{});
+    ++stats_.tracked;
+}
+
+void Ai_scheduler::clear()
+{
+    turns_.clear();
+    woken_.clear();
+    stats_.tracked = 0;
+}
+
+void Ai_scheduler::wake(entt::entity e)
+{
+    woken_.push_back(e);
+}
+
+void Ai_scheduler::run(entt::registry &reg, double now, glm::vec3 focus,
+                       Think const &think)
+{
+    using Clock = std::chrono::steady_clock;
+    auto deadline = Clock::now() + budget_;
+    now_ = now;
+    stats_.thinks = 0;
+    stats_.deferred = 0;
+
+    auto thinks = [&](entt::entity e) {
+        return reg.valid(e) && reg.all_of<Ai_tag, Position>(e);
+    };
+    auto &arena = reg.ctx().get<Frame_arena>();
+    std::pmr::vector<entt::entity> armies{&arena};
+    std::pmr::vector<float> dts{&arena};
+    armies.reserve(batch_size);
+    dts.reserve(batch_size);
+
+    // Woken armies react right away; their regular turn stays as it was.
+    std::ranges::sort(woken_);
+    auto [last, end] = std::ranges::unique(woken_);
+    woken_.erase(last, end);
+    std::erase_if(woken_, [&](entt::entity e) { return !thinks(e); });
+    for (std::size_t i{}; i < woken_.size(); i += batch_size) {
+        auto n = std::min(batch_size, woken_.size() - i);
+        dts.assign(n, 0);
+        think(std::span{woken_}.subspan(i, n), dts);
+        stats_.thinks += n;
+    }
+    woken_.clear();
+
+    // Armies rescheduled this frame go here rather than straight back on the
+    // heap, so that those thinking every tick come up once per frame.
+    std::pmr::vector<Turn> done{&arena};
+    while (!turns_.empty() && turns_.front().due <= now) {
+        // Always make some progress, however small the budget.
+        if (stats_.thinks != 0 && Clock::now() >= deadline) {
+            stats_.deferred = static_cast<std::size_t>(
+                std::ranges::count_if(turns_, [&](Turn const &turn) {
+                    return turn.due <= now;
+                }));
+            break;
+        }
+
+        armies.clear();
+        dts.clear();
+        while (armies.size() != batch_size && !turns_.empty() &&
+               turns_.front().due <= now) {
+            std::ranges::pop_heap(turns_, std::greater{});
+            auto turn = turns_.back();
+            turns_.pop_back();
+            if (!thinks(turn.e)) {
+                --stats_.tracked;
+                continue;
+            }
+            armies.push_back(turn.e);
+            dts.push_back(static_cast<float>(now - turn.last));
+        }
+        think(armies, dts);
+        stats_.thinks += armies.size();
+
+        for (auto e : armies) {
+            auto const &pos = reg.get<Position>(e).value;
+            auto distance = glm::distance(glm::vec2{pos.x, pos.z},
+                                          glm::vec2{focus.x, focus.z});
+            done.push_back(
+                Turn{.due = now + interval_at(distance), .last = now, .e = e});
+        }
+    }
+    for (auto const &turn : done) {
+        turns_.push_back(turn);
+        std::ranges::push_heap(turns_, std::greater{});
+    }
+}
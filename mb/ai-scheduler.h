@@ -0,0 +1,84 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <entt/entt.hpp>
+#include <functional>
+#include <glm/glm.hpp>
+#include <span>
+#include <vector>
+
+struct Ai_schedule_stats {
+    std::size_t tracked;
+    std::size_t thinks;   // in the last frame
+    std::size_t deferred; // due in the last frame but over budget
+};
+
+/// @brief Decides which AI armies think this frame.
+///
+/// Armies think less often the farther they are from the player, from every
+/// tick up close down to once a second far away. Due armies are kept in a
+/// heap, so a frame only touches those whose turn has come, and thinking stops
+/// once the frame's budget is spent; whoever is left over is the most overdue
+/// next frame.
+///
+/// Armies think in batches, so that their decisions can be scored together.
+///
+/// Tracks every entity that gets an Ai_tag once connected to its
+/// on_construct signal; destroyed or untagged entities are dropped when their
+/// turn comes.
+class Ai_scheduler {
+  public:
+    // Called with armies and, for each, the seconds since it last thought.
+    using Think = std::function<void(std::span<entt::entity const>,
+                                     std::span<float const>)>;
+
+    // Most armies handed to Think at once; also how often the budget is
+    // checked.
+    static constexpr std::size_t batch_size{64};
+
+    explicit Ai_scheduler(std::chrono::microseconds budget =
+                              std::chrono::microseconds{1000});
+    Ai_scheduler(Ai_scheduler const &) = delete;
+    Ai_scheduler(Ai_scheduler &&) = delete;
+    Ai_scheduler &operator=(Ai_scheduler const &) = delete;
+    Ai_scheduler &operator=(Ai_scheduler &&) = delete;
+    ~Ai_scheduler() = default;
+
+    void track(entt::registry &reg, entt::entity e);
+
+    // Forgets every army, e.g. before the world is replaced; they are
+    // tracked again as their Ai_tag comes back.
+    void clear();
+
+    // Has `e` think at the start of the next run, on top of its turn, e.g.
+    // because something came into view.
+    void wake(entt::entity e);
+
+    // Lets due armies think, at time `now` in seconds, with `focus` being
+    // where the player is.
+    void run(entt::registry &reg, double now, glm::vec3 focus,
+             Think const &think);
+
+    [[nodiscard]] Ai_schedule_stats stats() const
+    {
+        return stats_;
+    }
+
+  private:
+    struct Turn {
+        double due;
+        double last; // when the army last thought
+        entt::entity e;
+
+        bool operator>(Turn const &other) const
+        {
+            return due > other.due;
+        }
+    };
+
+    std::chrono::microseconds budget_;
+    double now_{};
+    std::vector<Turn> turns_; // min-heap on `due`
+    std::vector<entt::entity> woken_;
+    Ai_schedule_stats stats_{};
+};
@@ -1,59 +1,198 @@
+#include <mb/ai-scheduler.h>
+#include <mb/battle.h>
 #include <mb/components.h>
+#include <mb/frame-arena.h>
+#include <mb/random.h>
 #include <mb/systems.h>
+#include <mb/utility-ai.h>
 #include <spdlog/spdlog.h>
 
-bool chance(float p)
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <memory_resource>
+#include <numeric>
+#include <span>
+
+namespace {
+
+// How far fleeing armies try to get from who they flee.
+constexpr float flee_distance{2 * view_dist};
+// Simulated battles behind each forecast of the odds against a threat.
+constexpr std::size_t forecast_runs{32};
+
+float strength_of(Army const &army)
 {
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-    static std::uniform_real_distribution<float> dist(0.0F, 1.0F);
-    return dist(gen) < p;
+    return std::accumulate(army.stacks.begin(), army.stacks.end(), 0.0F,
+                           [](float sum, Troop_stack const &stack) {
+                               return sum + static_cast<float>(stack.size);
+                           });
 }
 
-void ai_system(entt::registry &reg, float dt)
+// Keeps the world's 100x100 bounds, like wandering does.
+glm::vec3 clamp_to_world(glm::vec3 p)
 {
-    // Collision handling
-    // for ()
-
-    auto armies = reg.view<Ai_tag, Army, Position>();
-    for (auto [e, army, pos] : armies.each()) {
-        if (army.perception.viewable_entity.size() > 1) {
-            auto src = e;
-            auto dest = army.perception.viewable_entity[1];
-            spdlog::debug("{} is tracing {} because target is in its view",
-                          static_cast<int>(src), static_cast<int>(dest));
-            reg.emplace_or_replace<Pathing>(
-                e, Pathing{.target_is_entity = true, .dest_e = dest});
-        }
-        else {
-            // Add cooldown component if missing
-            if (!reg.all_of<Ai_cooldown>(e)) {
-                reg.emplace<Ai_cooldown>(e,
-                                         Ai_cooldown{.timer = 0, .total = 1});
-            }
+    return {std::clamp(p.x, 0.0F, 100.0F), p.y, std::clamp(p.z, 0.0F, 100.0F)};
+}
 
-            auto &cd = reg.get<Ai_cooldown>(e);
-            cd.timer -= dt; // decrease by frame delta time
+void path_to(entt::registry &reg, entt::entity e, glm::vec3 dest)
+{
+    reg.emplace_or_replace<Pathing>(
+        e, Pathing{.target_is_entity = false, .dest_pos = dest});
+}
 
-            if (cd.timer > 0.0F) {
-                continue; // not ready yet
+// Per batch: what each army decided about, gathered next to the inputs.
+struct Batch_context {
+    std::pmr::vector<entt::entity> threat;
+    std::pmr::vector<glm::vec3> market;
+    std::pmr::vector<glm::vec3> wander;
+};
+
+// Fills `in` and `ctx` for `armies`. Draws from each army's stream, so
+// decisions replay exactly under the same world seed.
+void gather(entt::registry &reg, std::span<entt::entity const> armies,
+            std::span<float const> dts, std::span<glm::vec3 const> towns,
+            Ai_inputs &in, Batch_context &ctx)
+{
+    auto const &clock = reg.ctx().get<Sim_clock>();
+    auto const &random = reg.ctx().get<Random>();
+    auto const &roster = reg.ctx().get<Troop_roster>();
+    auto &arena = reg.ctx().get<Frame_arena>();
+    in.resize(armies.size());
+    ctx.threat.assign(armies.size(), entt::null);
+    ctx.market.assign(armies.size(), glm::vec3{});
+    ctx.wander.resize(armies.size());
+
+    for (std::size_t i{}; i != armies.size(); ++i) {
+        auto e = armies[i];
+        auto const &army = reg.get<Army>(e);
+        auto pos = reg.get<Position>(e).value;
+        glm::vec2 here{pos.x, pos.z};
+
+        in.money[i] = army.money;
+        in.threat[i] = 0;
+        in.threat_distance[i] = view_dist;
+        in.odds[i] = 1;
+        for (auto other : army.perception.viewable_entity) {
+            auto const &opos = reg.get<Position>(other).value;
+            auto d = glm::distance(here, glm::vec2{opos.x, opos.z});
+            if (d < in.threat_distance[i] || ctx.threat[i] == entt::null) {
+                in.threat[i] = strength_of(reg.get<Army>(other));
+                in.threat_distance[i] = d;
+                ctx.threat[i] = other;
             }
+        }
+        if (ctx.threat[i] != entt::null) {
+            std::array<Army const *, 2> sides{&army,
+                                              &reg.get<Army>(ctx.threat[i])};
+            in.odds[i] = Battle{sides, roster, &arena}.win_chances(
+                random, clock.tick, forecast_runs)[0];
+        }
+        in.market_distance[i] = std::numeric_limits<float>::infinity();
+        for (auto town : towns) {
+            auto d = glm::distance(here, glm::vec2{town.x, town.z});
+            if (d < in.market_distance[i]) {
+                in.market_distance[i] = d;
+                ctx.market[i] = town;
+            }
+        }
+
+        auto &cd = reg.get<Ai_cooldown>(e);
+        cd.timer -= dts[i];
+        in.rested[i] = cd.timer <= 0.0F ? 1.0F : 0.0F;
+        if (cd.timer <= 0.0F) {
             cd.timer = cd.total; // reset cooldown
+        }
+        auto rng = random.stream(Rng_domain::Ai, e, clock.tick);
+        in.roll[i] = rng.uniform();
+        ctx.wander[i] = {rng.uniform(0, 100), 0, rng.uniform(0, 100)};
+    }
+}
 
-            // Decide action
-            if (!reg.all_of<Pathing>(e)) {
-                if (chance(0.3F)) {
-                    std::random_device rd;
-                    std::mt19937 gen(rd());
-                    std::uniform_real_distribution<float> dist_x(0.0F, 100.0F);
-                    std::uniform_real_distribution<float> dist_y(0, 0);
-                    std::uniform_real_distribution<float> dist_z(0.0F, 100.0F);
-                    glm::vec3 random_pos{dist_x(gen), dist_y(gen), dist_z(gen)};
-                    reg.emplace<Pathing>(e, Pathing{.target_is_entity = false,
-                                                    .dest_pos = random_pos});
-                    spdlog::info("randomly wandering: {}", static_cast<int>(e));
-                }
-            }
+// Carries out what army `i` of the batch chose.
+void act(entt::registry &reg, entt::entity e, Ai_action action,
+         Batch_context const &ctx, std::size_t i)
+{
+    auto const *pathing = reg.try_get<Pathing>(e);
+    switch (action) {
+    case Ai_action::Idle:
+        break;
+    case Ai_action::Wander:
+        if (pathing == nullptr) {
+            path_to(reg, e, ctx.wander[i]);
+            spdlog::info("randomly wandering: {}", static_cast<int>(e));
+        }
+        break;
+    case Ai_action::Chase:
+        if (pathing == nullptr || !pathing->target_is_entity ||
+            pathing->dest_e != ctx.threat[i]) {
+            spdlog::debug("{} is tracing {} because target is in its view",
+                          static_cast<int>(e),
+                          static_cast<int>(ctx.threat[i]));
+            reg.emplace_or_replace<Pathing>(
+                e, Pathing{.target_is_entity = true, .dest_e = ctx.threat[i]});
+        }
+        break;
+    case Ai_action::Flee: {
+        if (ctx.threat[i] == entt::null) {
+            break;
+        }
+        auto pos = reg.get<Position>(e).value;
+        auto from = reg.get<Position>(ctx.threat[i]).value;
+        glm::vec3 away{pos.x - from.x, 0, pos.z - from.z};
+        away = glm::length(away) > 1e-5 ? glm::normalize(away)
+                                        : glm::vec3{1, 0, 0};
+        auto dest = clamp_to_world(pos + (away * flee_distance));
+        // Keep the route while the way out hasn't changed much.
+        if (pathing == nullptr || pathing->target_is_entity ||
+            glm::distance(pathing->dest_pos, dest) > view_dist / 2) {
+            spdlog::debug("{} flees from {}", static_cast<int>(e),
+                          static_cast<int>(ctx.threat[i]));
+            path_to(reg, e, dest);
         }
+        break;
     }
+    case Ai_action::Trade:
+        if (pathing == nullptr || pathing->target_is_entity ||
+            pathing->dest_pos != ctx.market[i]) {
+            spdlog::info("{} heads to market", static_cast<int>(e));
+            path_to(reg, e, ctx.market[i]);
+        }
+        break;
+    }
+}
+
+} // namespace
+
+/// @brief Lets the armies whose turn it is decide what to do, within the
+/// Ai_scheduler's budget.
+///
+/// Decisions are made a batch at a time: the batch's considerations are
+/// gathered into Ai_inputs, scored together by choose_actions, then acted on.
+void ai_system(entt::registry &reg)
+{
+    auto &scheduler = reg.ctx().get<Ai_scheduler>();
+    auto const &clock = reg.ctx().get<Sim_clock>();
+    auto &arena = reg.ctx().get<Frame_arena>();
+    glm::vec3 focus{};
+    for (auto [e, pos] : reg.view<Local_player_tag, Position>().each()) {
+        focus = pos.value;
+    }
+    std::pmr::vector<glm::vec3> towns{&arena};
+    for (auto [e, pos] : reg.view<comp::Town_tag, Position>().each()) {
+        towns.push_back(pos.value);
+    }
+
+    Ai_inputs in{&arena};
+    Batch_context ctx{.threat{&arena}, .market{&arena}, .wander{&arena}};
+    std::pmr::vector<Ai_action> chosen{&arena};
+    scheduler.run(reg, clock.time, focus,
+                  [&](std::span<entt::entity const> armies,
+                      std::span<float const> dts) {
+                      gather(reg, armies, dts, towns, in, ctx);
+                      choose_actions(in, chosen);
+                      for (std::size_t i{}; i != armies.size(); ++i) {
+                          act(reg, armies[i], chosen[i], ctx, i);
+                      }
+                  });
 }
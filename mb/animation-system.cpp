@@ -0,0 +1,50 @@
+#include <mb/components.h>
+#include <mb/frame-arena.h>
+#include <mb/model.h>
+#include <mb/systems.h>
+#include <mb/thread-pool.h>
+
+#include <cmath>
+#include <memory_resource>
+
+void animation_system(entt::registry &registry, Thread_pool &pool, float dt)
+{
+    struct Job {
+        Animator *animator;
+        Model const *model;
+    };
+    auto animated = registry.view<Animator, Renderable>();
+    std::pmr::vector<Job> jobs{&registry.ctx().get<Frame_arena>()};
+    jobs.reserve(animated.size_hint());
+    for (auto [e, animator, renderable] : animated.each()) {
+        auto clips = renderable.model->clips();
+        if (animator.clip >= clips.size()) {
+            continue;
+        }
+        // Parties only march while they are moving.
+        auto const *vel = registry.try_get<Velocity>(e);
+        if (vel == nullptr || vel->dir != glm::vec3{}) {
+            auto duration = clips[animator.clip].duration;
+            animator.time += dt * animator.speed;
+            animator.time =
+                duration > 0 ? std::fmod(animator.time, duration) : 0;
+        }
+        jobs.push_back(Job{.animator = &animator,
+                           .model = renderable.model.get()});
+    }
+
+    // Poses are independent of each other, so entities are spread over the
+    // workers; chunks of a few entities keep the scheduling cost negligible.
+    constexpr std::size_t grain{8};
+    pool.parallel_for(
+        jobs.size(), grain, [&](std::size_t begin, std::size_t end) {
+            for (auto i = begin; i != end; ++i) {
+                auto &animator = *jobs[i].animator;
+                auto const &skeleton = jobs[i].model->skeleton();
+                sample_clip(skeleton, jobs[i].model->clips()[animator.clip],
+                            animator.time, animator.pose);
+                build_palette(skeleton, animator.pose, animator.globals,
+                              animator.palette);
+            }
+        });
+}
@@ -0,0 +1,202 @@
+#include <mb/animation.h>
+
+#include <mb/simd.h>
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <glm/gtc/type_ptr.hpp>
+#include <utility>
+
+namespace {
+
+// Keyframe before `t` and how far `t` is towards the next one.
+std::pair<std::size_t, float> locate(std::vector<float> const &times, float t)
+{
+    if (times.size() == 1 || t <= times.front()) {
+        return {0, 0.0F};
+    }
+    if (t >= times.back()) {
+        return {times.size() - 1, 0.0F};
+    }
+    auto next = static_cast<std::size_t>(
+        std::ranges::upper_bound(times, t) - times.begin());
+    auto prev = next - 1;
+    return {prev, (t - times[prev]) / (times[next] - times[prev])};
+}
+
+#ifdef MB_SSE2
+
+__m128 load(glm::vec3 const &v)
+{
+    return _mm_setr_ps(v.x, v.y, v.z, 0.0F);
+}
+
+__m128 load(glm::quat const &q)
+{
+    return _mm_loadu_ps(glm::value_ptr(q));
+}
+
+__m128 lerp(__m128 a, __m128 b, float t)
+{
+    return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), _mm_set1_ps(t)));
+}
+
+// Dot product broadcast to every lane.
+__m128 dot4(__m128 a, __m128 b)
+{
+    __m128 m = _mm_mul_ps(a, b);
+    __m128 s = _mm_add_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_add_ps(s, _mm_shuffle_ps(s, s, _MM_SHUFFLE(1, 0, 3, 2)));
+}
+
+// Shortest-path normalized lerp; indistinguishable from slerp at the key
+// densities exported by DCC tools, and far cheaper.
+__m128 nlerp(__m128 a, __m128 b, float t)
+{
+    __m128 sign = _mm_and_ps(dot4(a, b), _mm_set1_ps(-0.0F));
+    __m128 r = lerp(a, _mm_xor_ps(b, sign), t);
+    return _mm_div_ps(r, _mm_sqrt_ps(dot4(r, r)));
+}
+
+// out = a * b. `out` may alias either operand.
+void multiply(glm::mat4 const &a, glm::mat4 const &b, glm::mat4 &out)
+{
+    std::array<__m128, 4> cols{
+        _mm_loadu_ps(glm::value_ptr(a[0])), _mm_loadu_ps(glm::value_ptr(a[1])),
+        _mm_loadu_ps(glm::value_ptr(a[2])), _mm_loadu_ps(glm::value_ptr(a[3]))};
+    std::array<__m128, 4> result{};
+    for (int i{}; i != 4; ++i) {
+        __m128 c = _mm_loadu_ps(glm::value_ptr(b[i]));
+        __m128 r = _mm_mul_ps(cols[0], _mm_shuffle_ps(c, c, 0x00));
+        r = _mm_add_ps(r, _mm_mul_ps(cols[1], _mm_shuffle_ps(c, c, 0x55)));
+        r = _mm_add_ps(r, _mm_mul_ps(cols[2], _mm_shuffle_ps(c, c, 0xAA)));
+        r = _mm_add_ps(r, _mm_mul_ps(cols[3], _mm_shuffle_ps(c, c, 0xFF)));
+        result[i] = r;
+    }
+    for (int i{}; i != 4; ++i) {
+        _mm_storeu_ps(glm::value_ptr(out[i]), result[i]);
+    }
+}
+
+glm::vec4 sample(Keyframes<glm::vec3> const &keys, float t, glm::vec4 rest)
+{
+    if (keys.times.empty()) {
+        return rest;
+    }
+    auto [k, f] = locate(keys.times, t);
+    auto next = std::min(k + 1, keys.values.size() - 1);
+    glm::vec4 out;
+    _mm_storeu_ps(glm::value_ptr(out),
+                  lerp(load(keys.values[k]), load(keys.values[next]), f));
+    return out;
+}
+
+glm::quat sample(Keyframes<glm::quat> const &keys, float t, glm::quat rest)
+{
+    if (keys.times.empty()) {
+        return rest;
+    }
+    auto [k, f] = locate(keys.times, t);
+    auto next = std::min(k + 1, keys.values.size() - 1);
+    glm::quat out;
+    _mm_storeu_ps(glm::value_ptr(out),
+                  nlerp(load(keys.values[k]), load(keys.values[next]), f));
+    return out;
+}
+
+#else
+
+void multiply(glm::mat4 const &a, glm::mat4 const &b, glm::mat4 &out)
+{
+    out = a * b;
+}
+
+glm::vec4 sample(Keyframes<glm::vec3> const &keys, float t, glm::vec4 rest)
+{
+    if (keys.times.empty()) {
+        return rest;
+    }
+    auto [k, f] = locate(keys.times, t);
+    auto next = std::min(k + 1, keys.values.size() - 1);
+    return {glm::mix(keys.values[k], keys.values[next], f), 0.0F};
+}
+
+glm::quat sample(Keyframes<glm::quat> const &keys, float t, glm::quat rest)
+{
+    if (keys.times.empty()) {
+        return rest;
+    }
+    auto [k, f] = locate(keys.times, t);
+    auto next = std::min(k + 1, keys.values.size() - 1);
+    auto b = keys.values[next];
+    if (glm::dot(keys.values[k], b) < 0) {
+        b = -b;
+    }
+    return glm::normalize(glm::lerp(keys.values[k], b, f));
+}
+
+#endif
+
+glm::mat4 compose(Joint_pose const &pose)
+{
+    glm::mat3 r = glm::mat3_cast(pose.rotation);
+    return {glm::vec4{r[0] * pose.scale.x, 0.0F},
+            glm::vec4{r[1] * pose.scale.y, 0.0F},
+            glm::vec4{r[2] * pose.scale.z, 0.0F},
+            glm::vec4{glm::vec3{pose.translation}, 1.0F}};
+}
+
+} // namespace
+
+int Skeleton::find(std::string_view name) const
+{
+    auto it = std::ranges::find(names, name);
+    return it == names.end() ? -1 : static_cast<int>(it - names.begin());
+}
+
+Animator make_animator(Skeleton const &skeleton, std::size_t clip)
+{
+    return Animator{.clip = clip,
+                    .time = 0,
+                    .speed = 1,
+                    .pose = skeleton.rest_pose,
+                    .globals = std::vector<glm::mat4>(skeleton.size()),
+                    .palette = std::vector<glm::mat4>(skeleton.size())};
+}
+
+void sample_clip(Skeleton const &skeleton, Animation_clip const &clip,
+                 float time, std::span<Joint_pose> pose)
+{
+    assert(pose.size() == skeleton.size());
+    assert(clip.tracks.size() == skeleton.size());
+    for (std::size_t j{}; j != skeleton.size(); ++j) {
+        auto const &track = clip.tracks[j];
+        auto const &rest = skeleton.rest_pose[j];
+        pose[j] = Joint_pose{
+            .translation = sample(track.translation, time, rest.translation),
+            .rotation = sample(track.rotation, time, rest.rotation),
+            .scale = sample(track.scale, time, rest.scale)};
+    }
+}
+
+void build_palette(Skeleton const &skeleton, std::span<Joint_pose const> pose,
+                   std::span<glm::mat4> globals, std::span<glm::mat4> palette)
+{
+    assert(pose.size() == skeleton.size());
+    assert(globals.size() == skeleton.size());
+    assert(palette.size() == skeleton.size());
+    for (std::size_t j{}; j != skeleton.size(); ++j) {
+        auto local = compose(pose[j]);
+        auto parent = skeleton.parents[j];
+        if (parent < 0) {
+            globals[j] = local;
+        }
+        else {
+            assert(static_cast<std::size_t>(parent) < j);
+            multiply(globals[parent], local, globals[j]);
+        }
+        multiply(skeleton.global_inverse, globals[j], palette[j]);
+        multiply(palette[j], skeleton.inverse_bind[j], palette[j]);
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <cstddef>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Padded to four lanes so that sampling works on whole SSE registers.
+struct Joint_pose {
+    glm::vec4 translation;
+    glm::quat rotation;
+    glm::vec4 scale;
+};
+
+// Joints are sorted so that every parent precedes its children, which lets
+// global transforms be computed in a single forward pass.
+struct Skeleton {
+    std::vector<std::string> names;
+    std::vector<int> parents; // -1 for the root
+    // Node transforms, used for joints a clip doesn't drive.
+    std::vector<Joint_pose> rest_pose;
+    // Mesh space -> joint space; identity for nodes that aren't bones.
+    std::vector<glm::mat4> inverse_bind;
+    glm::mat4 global_inverse{1};
+
+    [[nodiscard]] std::size_t size() const
+    {
+        return parents.size();
+    }
+
+    // -1 if there is no joint called `name`.
+    [[nodiscard]] int find(std::string_view name) const;
+};
+
+template <typename T> struct Keyframes {
+    std::vector<float> times; // seconds, ascending
+    std::vector<T> values;
+};
+
+struct Joint_track {
+    Keyframes<glm::vec3> translation;
+    Keyframes<glm::quat> rotation;
+    Keyframes<glm::vec3> scale;
+};
+
+struct Animation_clip {
+    std::string name;
+    float duration; // seconds
+    // Indexed by joint. Channels without keys fall back to the rest pose.
+    std::vector<Joint_track> tracks;
+};
+
+// Plays one clip of the entity's Renderable model, looping.
+struct Animator {
+    std::size_t clip;
+    float time;
+    float speed{1};
+    // Scratch and output, sized by make_animator so that evaluation never
+    // allocates.
+    std::vector<Joint_pose> pose;
+    std::vector<glm::mat4> globals;
+    std::vector<glm::mat4> palette;
+};
+
+Animator make_animator(Skeleton const &skeleton, std::size_t clip = 0);
+
+// Writes the local pose of every joint at `time` (seconds, already wrapped
+// into the clip).
+void sample_clip(Skeleton const &skeleton, Animation_clip const &clip,
+                 float time, std::span<Joint_pose> pose);
+
+// Turns a local pose into skinning matrices: mesh space -> animated mesh
+// space, one per joint.
+void build_palette(Skeleton const &skeleton, std::span<Joint_pose const> pose,
+                   std::span<glm::mat4> globals, std::span<glm::mat4> palette);
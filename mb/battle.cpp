@@ -0,0 +1,183 @@
+#include <mb/battle.h>
+
+#include <mb/thread-pool.h>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace {
+
+// Damage that takes one soldier out before armor.
+constexpr float soldier_health{10};
+// Armor at which half the damage gets through.
+constexpr float armor_half{10};
+// Battles that last this long are called off; the strongest side wins.
+constexpr int max_rounds{100};
+// Sides with fewer soldiers than this have been routed.
+constexpr float routed{0.5F};
+
+} // namespace
+
+Battle::Battle(std::span<Army const *const> sides, Troop_roster const &roster,
+               std::pmr::memory_resource *memory)
+    : soldiers_{memory}, damage_{memory}, losses_per_damage_{memory},
+      troop_ids_{memory}, side_end_{memory}
+{
+    for (auto const *army : sides) {
+        for (auto const &stack : army->stacks) {
+            auto armor = static_cast<float>(
+                std::max(roster.get<troop::Armor>(stack.troop_id), 0));
+            auto damage = static_cast<float>(
+                std::max(roster.get<troop::Damage>(stack.troop_id), 0));
+            soldiers_.push_back(static_cast<float>(stack.size));
+            damage_.push_back(damage);
+            losses_per_damage_.push_back(armor_half / (armor_half + armor) /
+                                         soldier_health);
+            troop_ids_.push_back(stack.troop_id);
+        }
+        side_end_.push_back(soldiers_.size());
+    }
+}
+
+int Battle::fight(std::span<float> soldiers, Random_stream &rng) const
+{
+    auto sides = side_end_.size();
+    auto n = soldiers.size();
+    // Reused across battles on each thread.
+    thread_local std::vector<float> dealt;
+    thread_local std::vector<float> side_dealt;
+    thread_local std::vector<float> side_soldiers;
+    dealt.resize(n);
+    side_dealt.resize(sides);
+    side_soldiers.resize(sides);
+
+    auto side_begin = [&](std::size_t k) {
+        return k == 0 ? 0 : side_end_[k - 1];
+    };
+    auto sum_sides = [&](std::span<float const> column,
+                         std::vector<float> &out) {
+        for (std::size_t k{}; k != sides; ++k) {
+            out[k] = std::reduce(column.begin() + side_begin(k),
+                                 column.begin() + side_end_[k], 0.0F);
+        }
+    };
+
+    int round{};
+    for (; round != max_rounds; ++round) {
+        sum_sides(soldiers, side_soldiers);
+        auto standing = static_cast<std::size_t>(
+            std::ranges::count_if(side_soldiers, [](float s) {
+                return s >= routed;
+            }));
+        if (standing <= 1) {
+            break;
+        }
+
+        // Damage dealt by each stack: soldiers x damage x a spread in
+        // [0.5, 1.5).
+        rng.fill_uniform(dealt);
+        for (std::size_t i{}; i != n; ++i) {
+            dealt[i] = soldiers[i] * damage_[i] * (0.5F + dealt[i]);
+        }
+        sum_sides(dealt, side_dealt);
+        auto total = std::reduce(side_dealt.begin(), side_dealt.end(), 0.0F);
+
+        for (std::size_t k{}; k != sides; ++k) {
+            if (side_soldiers[k] < routed) {
+                continue;
+            }
+            // Every other standing side sends this one its share.
+            auto incoming = (total - side_dealt[k]) /
+                            static_cast<float>(standing - 1);
+            auto per_soldier = incoming / side_soldiers[k];
+            for (auto i = side_begin(k); i != side_end_[k]; ++i) {
+                auto left = soldiers[i] -
+                            (soldiers[i] * per_soldier * losses_per_damage_[i]);
+                soldiers[i] = left > 0 ? left : 0;
+            }
+        }
+    }
+    return round;
+}
+
+std::size_t Battle::winner_of(std::span<float const> soldiers) const
+{
+    std::size_t winner{side_end_.size()};
+    float most{routed};
+    std::size_t begin{};
+    for (std::size_t k{}; k != side_end_.size(); ++k) {
+        auto left = std::reduce(soldiers.begin() + begin,
+                                soldiers.begin() + side_end_[k], 0.0F);
+        if (left >= most) {
+            most = left;
+            winner = k;
+        }
+        begin = side_end_[k];
+    }
+    return winner;
+}
+
+Battle_outcome Battle::resolve(Random_stream rng) const
+{
+    auto soldiers = soldiers_;
+    Battle_outcome outcome{.winner = 0, .survivors = {}, .rounds = 0};
+    outcome.rounds = fight(soldiers, rng);
+    outcome.winner = winner_of(soldiers);
+
+    std::size_t begin{};
+    for (auto end : side_end_) {
+        auto &side = outcome.survivors.emplace_back();
+        for (auto i = begin; i != end; ++i) {
+            auto left = static_cast<std::size_t>(std::lround(soldiers[i]));
+            if (left != 0) {
+                side.push_back(
+                    Troop_stack{.size = left, .troop_id = troop_ids_[i]});
+            }
+        }
+        begin = end;
+    }
+    return outcome;
+}
+
+std::pmr::vector<float> Battle::win_chances(Random const &random,
+                                            std::uint64_t tick,
+                                            std::size_t runs,
+                                            Thread_pool *pool) const
+{
+    auto sides = side_end_.size();
+    auto *memory = soldiers_.get_allocator().resource();
+    // Wins per side, per run; summed once every run is done.
+    std::pmr::vector<std::uint8_t> won(runs * sides, memory);
+    auto simulate = [&](std::size_t begin, std::size_t end) {
+        // Runs on workers, which mustn't allocate from `memory`.
+        thread_local std::vector<float> soldiers;
+        for (auto run = begin; run != end; ++run) {
+            soldiers.assign(soldiers_.begin(), soldiers_.end());
+            auto rng = random.stream(Rng_domain::Forecast,
+                                     static_cast<std::uint32_t>(run), tick);
+            fight(soldiers, rng);
+            auto winner = winner_of(soldiers);
+            if (winner != sides) {
+                won[(run * sides) + winner] = 1;
+            }
+        }
+    };
+    if (pool != nullptr) {
+        pool->parallel_for(runs, 16, simulate);
+    }
+    else {
+        simulate(0, runs);
+    }
+
+    std::pmr::vector<float> chances(sides, memory);
+    for (std::size_t run{}; run != runs; ++run) {
+        for (std::size_t k{}; k != sides; ++k) {
+            chances[k] += won[(run * sides) + k];
+        }
+    }
+    for (auto &c : chances) {
+        c /= static_cast<float>(std::max<std::size_t>(runs, 1));
+    }
+    return chances;
+}
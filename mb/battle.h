@@ -0,0 +1,56 @@
+#pragma once
+#include <mb/random.h>
+#include <mb/troop.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <span>
+#include <vector>
+
+class Thread_pool;
+
+struct Battle_outcome {
+    std::size_t winner; // index of the winning side; sides.size() if none
+    std::vector<Army_stacks> survivors; // per side
+    int rounds;
+};
+
+/// @brief Auto-resolves a battle between two or more armies.
+///
+/// The stacks of every side are laid out as columns (soldiers, damage, losses
+/// per damage taken), side after side. A round is a handful of loops down those
+/// columns: every stack deals damage with a random spread, each side splits
+/// its total evenly over the enemy sides, and each enemy side spreads it over
+/// its stacks by size. Soldiers are fractional while fighting and rounded
+/// when the battle ends.
+///
+/// A Battle is immutable once built, so forecasts can run in parallel. Its
+/// columns, and forecast results, come from `memory`, e.g. the Frame_arena
+/// for a battle that is only forecast.
+class Battle {
+  public:
+    Battle(std::span<Army const *const> sides, Troop_roster const &roster,
+           std::pmr::memory_resource *memory =
+               std::pmr::get_default_resource());
+
+    [[nodiscard]] Battle_outcome resolve(Random_stream rng) const;
+
+    // How often each side wins over `runs` simulated battles; runs draw from
+    // Rng_domain::Forecast streams and are spread over `pool` if given.
+    [[nodiscard]] std::pmr::vector<float>
+    win_chances(Random const &random, std::uint64_t tick, std::size_t runs,
+                Thread_pool *pool = nullptr) const;
+
+  private:
+    // Fights with `soldiers` until at most one side stands; returns the
+    // rounds fought.
+    int fight(std::span<float> soldiers, Random_stream &rng) const;
+    [[nodiscard]] std::size_t winner_of(std::span<float const> soldiers) const;
+
+    std::pmr::vector<float> soldiers_;
+    std::pmr::vector<float> damage_;
+    std::pmr::vector<float> losses_per_damage_; // soldiers, after armor
+    std::pmr::vector<std::size_t> troop_ids_;
+    std::pmr::vector<std::size_t> side_end_; // one past each side's last stack
+};
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <mb/path-service.h>
 #include <mb/texture.h>
 
 #include <entt/entt.hpp>
@@ -11,6 +12,12 @@ struct Pathing {
     bool target_is_entity;
     glm::vec3 dest_pos;
     entt::entity dest_e;
+
+    // Maintained by pathing_system: the route being followed, the cell it
+    // leads to, and the waypoint being walked towards.
+    Path_handle route;
+    Grid_cell route_goal{.x = -1, .z = -1};
+    std::size_t next_waypoint{};
 };
 
 struct Position {
@@ -43,6 +50,17 @@ struct Transform {
     glm::vec3 rotation{0, 0, 0};
 };
 
+// Position * rotation * scale of a Renderable, and the matrix its normals
+// go through; kept by world_matrix_system.
+struct World_matrix {
+    glm::mat4 model{1};
+    glm::mat3 normal{1};
+};
+
+// Position, Transform or Renderable changed since the last
+// world_matrix_system; see track_world_matrices.
+struct World_matrix_dirty {};
+
 struct Ai_tag {};
 
 struct Ai_cooldown {
@@ -1,4 +1,5 @@
 #pragma once
+#include <mb/animation.h>
 #include <mb/camera.h>
 #include <mb/common-components.h>
 #include <mb/dialog.h>
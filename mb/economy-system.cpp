@@ -0,0 +1,40 @@
+#include <mb/components.h>
+#include <mb/economy.h>
+#include <mb/systems.h>
+
+#include <algorithm>
+#include <cmath>
+
+void economy_system(entt::registry &reg)
+{
+    auto &economy = reg.ctx().get<Economy>();
+    auto const &clock = reg.ctx().get<Sim_clock>();
+    economy.advance_to(
+        static_cast<std::uint64_t>(std::floor(clock.time / economy_day)));
+
+    auto state = economy.take_published();
+    if (!state) {
+        return;
+    }
+
+    // Armies pay their troops once a day, as far as their money goes.
+    auto const &roster = reg.ctx().get<Troop_roster>();
+    for (auto [e, army] : reg.view<Army>().each()) {
+        army.money = std::max(army.money - army_upkeep(army, roster), 0.0F);
+    }
+
+    auto goods = economy.goods().size();
+    auto towns = economy.towns();
+    for (std::size_t t{}; t != towns.size(); ++t) {
+        auto const *market = reg.try_get<comp::Market>(towns[t]);
+        if (market == nullptr) {
+            continue;
+        }
+        for (auto item_e : market->items) {
+            auto &item = reg.get<comp::Item>(item_e);
+            if (auto g = economy.good_of(item.name); g != goods) {
+                item.price = state->price[(t * goods) + g];
+            }
+        }
+    }
+}
@@ -0,0 +1,218 @@
+#include <mb/economy.h>
+
+#include <mb/thread-pool.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <spdlog/spdlog.h>
+
+namespace {
+
+// Days of consumption a town likes to keep in stock; prices rise below it
+// and fall above it.
+constexpr float days_of_cover{7};
+// How strongly prices follow the stock: price ~ (wanted / stock) ^ this.
+constexpr float price_elasticity{0.5F};
+// Prices stay within these multiples of the base price.
+constexpr float min_price_factor{0.25F};
+constexpr float max_price_factor{4};
+// Share of the gap to the new price closed per day.
+constexpr float price_inertia{0.3F};
+// Share of the gap to the neighbours' average price closed per day, standing
+// in for traders.
+constexpr float price_diffusion{0.1F};
+// Towns this close trade with each other.
+constexpr float trade_range{150};
+// Towns per batch handed to a worker.
+constexpr std::size_t town_batch{32};
+
+} // namespace
+
+Economy::Economy(std::vector<Good> goods, Thread_pool &pool)
+    : goods_{std::move(goods)}, pool_{&pool}
+{
+    state_.store(std::make_shared<Economy_state const>());
+}
+
+Economy::~Economy()
+{
+    // A tick captures `this`.
+    if (ticking_.valid()) {
+        ticking_.wait();
+    }
+}
+
+void Economy::add_town(entt::entity town, glm::vec3 pos,
+                       std::span<float const> production,
+                       std::span<float const> consumption)
+{
+    if (production.size() != goods_.size() ||
+        consumption.size() != goods_.size()) {
+        spdlog::error("Economy: town {} has {} production and {} consumption "
+                      "rates for {} goods",
+                      static_cast<int>(town), production.size(),
+                      consumption.size(), goods_.size());
+        throw std::runtime_error("check last error");
+    }
+    if (started_) {
+        spdlog::error("Economy: town {} added after the first day",
+                      static_cast<int>(town));
+        throw std::runtime_error("check last error");
+    }
+    towns_.push_back(town);
+    positions_.emplace_back(pos.x, pos.z);
+    production_.insert(production_.end(), production.begin(),
+                       production.end());
+    consumption_.insert(consumption_.end(), consumption.begin(),
+                        consumption.end());
+}
+
+void Economy::start()
+{
+    started_ = true;
+    link_towns();
+    publish_first_day();
+}
+
+void Economy::publish_first_day()
+{
+    // Towns start with their wanted stock at base prices.
+    auto state = std::make_shared<Economy_state>();
+    state->stock.reserve(consumption_.size());
+    state->price.reserve(consumption_.size());
+    for (std::size_t t{}; t != towns_.size(); ++t) {
+        for (std::size_t g{}; g != goods_.size(); ++g) {
+            state->stock.push_back(consumption_[(t * goods_.size()) + g] *
+                                   days_of_cover);
+            state->price.push_back(goods_[g].base_price);
+        }
+    }
+    state_.store(std::move(state));
+}
+
+void Economy::reset()
+{
+    if (ticking_.valid()) {
+        ticking_.get();
+    }
+    if (started_) {
+        publish_first_day();
+    }
+    taken_day_ = 0;
+}
+
+void Economy::link_towns()
+{
+    neighbours_.clear();
+    neighbours_begin_.clear();
+    for (std::size_t t{}; t != towns_.size(); ++t) {
+        neighbours_begin_.push_back(neighbours_.size());
+        for (std::size_t u{}; u != towns_.size(); ++u) {
+            if (u != t &&
+                glm::distance(positions_[t], positions_[u]) <= trade_range) {
+                neighbours_.push_back(static_cast<std::uint32_t>(u));
+            }
+        }
+    }
+    neighbours_begin_.push_back(neighbours_.size());
+}
+
+std::size_t Economy::good_of(std::string const &name) const
+{
+    return static_cast<std::size_t>(
+        std::ranges::find(goods_, name, &Good::name) - goods_.begin());
+}
+
+std::shared_ptr<Economy_state const> Economy::take_published()
+{
+    auto state = state_.load();
+    if (state->day == taken_day_) {
+        return nullptr;
+    }
+    taken_day_ = state->day;
+    return state;
+}
+
+void Economy::advance_to(std::uint64_t day)
+{
+    if (!started_) {
+        start();
+    }
+    if (ticking_.valid()) {
+        if (ticking_.wait_for(std::chrono::seconds{0}) !=
+            std::future_status::ready) {
+            return;
+        }
+        ticking_.get();
+    }
+    auto today = state_.load();
+    if (day <= today->day) {
+        return;
+    }
+    ticking_ = pool_->submit([this, today = std::move(today), day] {
+        auto start = std::chrono::steady_clock::now();
+        auto next = std::make_shared<Economy_state const>(tick(*today, day));
+        std::chrono::duration<double, std::milli> took{
+            std::chrono::steady_clock::now() - start};
+        spdlog::debug("Economy: day {} of {} towns took {:.3f} ms", day,
+                      towns_.size(), took.count());
+        state_.store(std::move(next));
+    });
+}
+
+Economy_state Economy::tick(Economy_state const &today,
+                            std::uint64_t day) const
+{
+    auto goods = goods_.size();
+    Economy_state next{.day = day, .stock = today.stock, .price = today.price};
+
+    // Production, consumption and local prices. Each town only touches its
+    // own goods.
+    pool_->parallel_for(towns_.size(), town_batch, [&](std::size_t begin,
+                                                       std::size_t end) {
+        for (auto t = begin; t != end; ++t) {
+            auto *stock = next.stock.data() + (t * goods);
+            auto *price = next.price.data() + (t * goods);
+            auto const *made = production_.data() + (t * goods);
+            auto const *used = consumption_.data() + (t * goods);
+            for (std::size_t g{}; g != goods; ++g) {
+                auto left = stock[g] + made[g] - used[g];
+                stock[g] = left > 0 ? left : 0;
+            }
+            for (std::size_t g{}; g != goods; ++g) {
+                auto wanted = std::max(used[g] * days_of_cover, 1.0F);
+                auto factor = std::clamp(
+                    std::pow(wanted / std::max(stock[g], 1.0F),
+                             price_elasticity),
+                    min_price_factor, max_price_factor);
+                auto target = goods_[g].base_price * factor;
+                price[g] += (target - price[g]) * price_inertia;
+            }
+        }
+    });
+
+    // Prices drift towards those of trading partners. Reads the prices above
+    // and writes a separate copy, so towns can go in any order.
+    auto local = next.price;
+    pool_->parallel_for(towns_.size(), town_batch, [&](std::size_t begin,
+                                                       std::size_t end) {
+        for (auto t = begin; t != end; ++t) {
+            auto first = neighbours_begin_[t];
+            auto last = neighbours_begin_[t + 1];
+            if (first == last) {
+                continue;
+            }
+            auto *price = next.price.data() + (t * goods);
+            auto weight = price_diffusion / static_cast<float>(last - first);
+            for (auto n = first; n != last; ++n) {
+                auto const *theirs = local.data() + (neighbours_[n] * goods);
+                auto const *ours = local.data() + (t * goods);
+                for (std::size_t g{}; g != goods; ++g) {
+                    price[g] += (theirs[g] - ours[g]) * weight;
+                }
+            }
+        }
+    });
+    return next;
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <entt/entt.hpp>
+#include <future>
+#include <glm/glm.hpp>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+class Thread_pool;
+
+// Sim_clock seconds per economy day.
+constexpr double economy_day{30};
+
+struct Good {
+    std::string name; // matches component::Item::name
+    float base_price;
+};
+
+// Stock and prices of every good in every town as of some day, town by town:
+// element [town * goods + good].
+struct Economy_state {
+    std::uint64_t day;
+    std::vector<float> stock;
+    std::vector<float> price;
+};
+
+/// @brief Daily production, consumption and prices of goods across towns.
+///
+/// Towns and goods are fixed once the first day is ticked. Each day runs on
+/// the thread pool against an immutable Economy_state and, once done, is
+/// published with one atomic pointer swap; the frame thread only ever reads
+/// a complete day. Towns are split across workers in batches, and each
+/// town's goods are contiguous, so the inner loops run down flat arrays.
+///
+/// Lives in the registry's context.
+class Economy {
+  public:
+    Economy(std::vector<Good> goods, Thread_pool &pool);
+    Economy(Economy const &) = delete;
+    Economy(Economy &&) = delete;
+    Economy &operator=(Economy const &) = delete;
+    Economy &operator=(Economy &&) = delete;
+    ~Economy();
+
+    // Units made and used up per day, one per good. Only before the first
+    // advance_to.
+    void add_town(entt::entity town, glm::vec3 pos,
+                  std::span<float const> production,
+                  std::span<float const> consumption);
+
+    // Starts ticking `day` in the background unless a tick is running or it
+    // was ticked already. Days missed meanwhile are skipped.
+    void advance_to(std::uint64_t day);
+
+    // Goes back to day 0, after any day being ticked, e.g. because the world
+    // was loaded from a snapshot; the next advance_to catches up from there.
+    void reset();
+
+    [[nodiscard]] std::shared_ptr<Economy_state const> latest() const
+    {
+        return state_.load();
+    }
+    // The latest day if it wasn't taken yet, else nullptr. Frame thread only.
+    [[nodiscard]] std::shared_ptr<Economy_state const> take_published();
+
+    [[nodiscard]] std::span<Good const> goods() const
+    {
+        return goods_;
+    }
+    // Index of the good called `name`, or goods().size().
+    [[nodiscard]] std::size_t good_of(std::string const &name) const;
+    [[nodiscard]] std::span<entt::entity const> towns() const
+    {
+        return towns_;
+    }
+
+  private:
+    [[nodiscard]] Economy_state tick(Economy_state const &today,
+                                     std::uint64_t day) const;
+    // Links trading partners and publishes day 0.
+    void start();
+    void publish_first_day();
+    void link_towns();
+
+    std::vector<Good> goods_;
+    Thread_pool *pool_;
+    bool started_{};
+
+    std::vector<entt::entity> towns_;
+    std::vector<glm::vec2> positions_;
+    std::vector<float> production_;  // [town * goods + good]
+    std::vector<float> consumption_; // [town * goods + good]
+    // Towns trading with each town, and where each town's list begins.
+    std::vector<std::uint32_t> neighbours_;
+    std::vector<std::size_t> neighbours_begin_;
+
+    std::atomic<std::shared_ptr<Economy_state const>> state_;
+    std::uint64_t taken_day_{};
+    std::future<void> ticking_;
+};
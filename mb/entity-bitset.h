@@ -0,0 +1,43 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <entt/entt.hpp>
+#include <vector>
+
+/// @brief Set of entities as one bit per entity slot.
+///
+/// Tests are a shift and a mask. Versions are ignored, so a destroyed
+/// entity's bit carries over to whoever reuses its slot until it is reset.
+class Entity_bitset {
+  public:
+    void set(entt::entity e)
+    {
+        auto slot = entt::to_entity(e);
+        if (slot / bits >= words_.size()) {
+            words_.resize((slot / bits) + 1);
+        }
+        words_[slot / bits] |= std::uint64_t{1} << (slot % bits);
+    }
+    void reset(entt::entity e)
+    {
+        auto slot = entt::to_entity(e);
+        if (slot / bits < words_.size()) {
+            words_[slot / bits] &= ~(std::uint64_t{1} << (slot % bits));
+        }
+    }
+    [[nodiscard]] bool test(entt::entity e) const
+    {
+        auto slot = entt::to_entity(e);
+        return slot / bits < words_.size() &&
+               ((words_[slot / bits] >> (slot % bits)) & 1U) != 0;
+    }
+    void clear()
+    {
+        words_.clear();
+    }
+
+  private:
+    static constexpr std::size_t bits{64};
+
+    std::vector<std::uint64_t> words_;
+};
@@ -0,0 +1,14 @@
+#include <mb/entity-factory.h>
+
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+
+Prototype const &Entity_factory::prototype(std::string const &name) const
+{
+    auto it = prototypes_.find(name);
+    if (it == prototypes_.end()) {
+        spdlog::error("unable to find prototype {}", name);
+        throw std::runtime_error("check last error");
+    }
+    return it->second;
+}
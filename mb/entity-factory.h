@@ -1,8 +1,85 @@
 #pragma once
+#include <algorithm>
+#include <cstddef>
 #include <entt/entt.hpp>
-#include <filesystem>
-#include <spdlog/spdlog.h>
+#include <memory>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
+/// @brief The components an entity of some kind starts with.
+///
+/// Holds one value per component type. Stamping copies each value to a whole
+/// range of entities with one bulk insert per storage, so the copies of one
+/// component are constructed back to back.
+class Prototype {
+  public:
+    // Sets the component of type T, replacing any earlier value.
+    template <typename T>
+    Prototype &with(T value)
+    {
+        auto id = entt::type_hash<T>::value();
+        auto it = std::ranges::find(components_, id, &Component::id);
+        auto typed = std::make_unique<Typed<T>>(id, std::move(value));
+        if (it != components_.end()) {
+            *it = std::move(typed);
+        }
+        else {
+            components_.push_back(std::move(typed));
+        }
+        return *this;
+    }
+
+    // Gives every entity in `entities` a copy of each component.
+    void stamp(entt::registry &registry,
+               std::span<entt::entity const> entities) const
+    {
+        for (auto const &component : components_) {
+            component->insert(registry, entities);
+        }
+    }
+
+  private:
+    struct Component {
+        explicit Component(entt::id_type id) : id{id} {}
+        Component(Component const &) = delete;
+        Component(Component &&) = delete;
+        Component &operator=(Component const &) = delete;
+        Component &operator=(Component &&) = delete;
+        virtual ~Component() = default;
+
+        virtual void insert(entt::registry &registry,
+                            std::span<entt::entity const> entities) const = 0;
+
+        entt::id_type id;
+    };
+
+    template <typename T>
+    struct Typed final : Component {
+        Typed(entt::id_type id, T value)
+            : Component{id}, value{std::move(value)}
+        {
+        }
+
+        void insert(entt::registry &registry,
+                    std::span<entt::entity const> entities) const override
+        {
+            auto &storage = registry.storage<T>();
+            storage.reserve(storage.size() + entities.size());
+            registry.insert<T>(entities.begin(), entities.end(), value);
+        }
+
+        T value;
+    };
+
+    std::vector<std::unique_ptr<Component>> components_;
+};
+
+/// @brief Spawns entities from named prototypes.
+///
+/// Lives in the registry's context.
 class Entity_factory {
   public:
     Entity_factory(Entity_factory const &) = delete;
@@ -13,23 +90,38 @@ class Entity_factory {
     // (maybe).
     explicit Entity_factory(entt::registry &registry) : registry_(registry) {}
 
-    void register_prototype(std::string const &name, entt::entity id)
+    // Returns the prototype called `name`, empty if it is new, to fill in.
+    Prototype &register_prototype(std::string const &name)
     {
-        prototypes_[name] = id;
+        return prototypes_[name];
     }
 
+    [[nodiscard]] Prototype const &prototype(std::string const &name) const;
+
     entt::entity make_entity(std::string const &prototype_name)
     {
-        auto it = prototypes_.find(prototype_name);
-        if (it == prototypes_.end()) {
-            spdlog::error("unable to find prototype");
-            throw std::runtime_error("check last error");
-        }
+        return spawn_n(prototype_name, 1, [](entt::entity, std::size_t) {})
+            .front();
+    }
 
-        it->second;
+    // Creates `count` entities from the prototype, then calls
+    // `init(entity, i)` on each, e.g. to place it. Entities are created and
+    // each component stamped in bulk, with storages reserved up front.
+    template <typename Init>
+    std::vector<entt::entity> spawn_n(std::string const &prototype_name,
+                                      std::size_t count, Init &&init)
+    {
+        auto const &proto = prototype(prototype_name);
+        std::vector<entt::entity> entities(count);
+        registry_.create(entities.begin(), entities.end());
+        proto.stamp(registry_, entities);
+        for (std::size_t i{}; i != count; ++i) {
+            init(entities[i], i);
+        }
+        return entities;
     }
 
   private:
     entt::registry &registry_;
-    std::unordered_map<std::string, entt::entity> prototypes_;
+    std::unordered_map<std::string, Prototype> prototypes_;
 };
@@ -1,8 +1,49 @@
 #include "spdlog/spdlog.h"
 #include <mb/events.h>
 
+#include <array>
 #include <entt/entt.hpp>
+#include <mb/ai-scheduler.h>
+#include <mb/battle.h>
 #include <mb/game.h>
+#include <mb/random.h>
+
+namespace {
+
+// Auto-resolves a battle between `armies` and leaves each with its
+// survivors. Routed AI armies are destroyed; the local player is kept even
+// with nothing left.
+Battle_outcome fight_battle(entt::registry &reg,
+                            std::span<entt::entity const> armies)
+{
+    std::vector<Army const *> sides;
+    for (auto e : armies) {
+        sides.push_back(&reg.get<Army>(e));
+    }
+    auto rng = reg.ctx().get<Random>().stream(
+        Rng_domain::Battle, armies.front(), reg.ctx().get<Sim_clock>().tick);
+    auto outcome =
+        Battle{sides, reg.ctx().get<Troop_roster>()}.resolve(rng);
+    spdlog::info("Battle of {} armies over after {} rounds, side {} won",
+                 armies.size(), outcome.rounds, outcome.winner);
+
+    for (std::size_t i{}; i != armies.size(); ++i) {
+        auto e = armies[i];
+        auto &survivors = outcome.survivors[i];
+        if (survivors.empty() && !reg.all_of<Local_player_tag>(e)) {
+            reg.destroy(e);
+            continue;
+        }
+        auto &army = reg.get<Army>(e);
+        army.stacks = std::move(survivors);
+        if (auto *vel = reg.try_get<Velocity>(e); vel != nullptr) {
+            vel->speed = army_speed(army, reg.ctx().get<Troop_roster>());
+        }
+    }
+    return outcome;
+}
+
+} // namespace
 
 comp::Dialog_option make_exit_option(entt::registry &reg, entt::entity dialog_e)
 {
@@ -26,7 +67,22 @@ void process_collision_event(Collision_event const &e)
     // Collides with Army or Town?
     if (e.registry->all_of<Army>(e.other)) {
         // Creates army dialogs
-        auto out_of_my_way = []() { spdlog::info("ljf sb"); };
+        auto out_of_my_way = [registry{e.registry}, self{e.self},
+                              other{e.other}, dialog_e]() {
+            // Removing the Dialog destroys this closure, so it goes last.
+            auto &reg = *registry;
+            auto dialog = dialog_e;
+            reg.ctx().get<Game_state>() = Game_state::Normal;
+            std::array armies{self, other};
+            auto outcome = fight_battle(reg, armies);
+            if (outcome.winner == 0) {
+                spdlog::info("You won the battle");
+            }
+            else {
+                spdlog::info("You were defeated");
+            }
+            reg.remove<comp::Dialog>(dialog);
+        };
         comp::Dialog_option fuck_option{.reply = "Out of my way!",
                                         .action = out_of_my_way};
         options.push_back(fuck_option);
@@ -35,10 +91,11 @@ void process_collision_event(Collision_event const &e)
             .scripts{"I'm here to block you way! Surrender now!"},
             .current_line = 0,
             .options{std::move(options)}};
-        e.registry->emplace<comp::Dialog>(dialog_e, dialog);
+        e.registry->emplace<comp::Dialog>(dialog_e, std::move(dialog));
     }
     else { // Town
         auto const &market = e.registry->get<comp::Market>(e.other);
+        options.reserve(market.items.size() + 1);
         for (auto item_e : market.items) {
             auto item = e.registry->get<comp::Item>(item_e);
             auto buy = [registry{e.registry}, item, dialog_e]() {
@@ -56,6 +113,41 @@ void process_collision_event(Collision_event const &e)
         comp::Dialog dialog{.scripts{"What do you want?"},
                             .current_line = 0,
                             .options{std::move(options)}};
-        e.registry->emplace<comp::Dialog>(dialog_e, dialog);
+        e.registry->emplace<comp::Dialog>(dialog_e, std::move(dialog));
+    }
+}
+
+void process_entered_view_event(Entered_view const &e)
+{
+    auto &reg = *e.registry;
+    if (reg.all_of<Ai_tag>(e.viewer)) {
+        reg.ctx().get<Ai_scheduler>().wake(e.viewer);
+    }
+}
+
+void process_left_view_event(Left_view const &e)
+{
+    auto &reg = *e.registry;
+    if (reg.all_of<Ai_tag>(e.viewer)) {
+        reg.ctx().get<Ai_scheduler>().wake(e.viewer);
+    }
+    auto const *pathing = reg.try_get<Pathing>(e.viewer);
+    if (pathing == nullptr || !pathing->target_is_entity ||
+        pathing->dest_e != e.seen) {
+        return;
+    }
+    spdlog::info("{} lost view of {}, stop pathing", static_cast<int>(e.viewer),
+                 static_cast<int>(e.seen));
+    reg.remove<Pathing>(e.viewer);
+}
+
+void process_battle_event(Battle_event const &e)
+{
+    auto &reg = *e.registry;
+    // Either may have fallen in another battle this frame.
+    if (!reg.valid(e.first) || !reg.valid(e.second)) {
+        return;
     }
+    std::array armies{e.first, e.second};
+    fight_battle(reg, armies);
 }
@@ -10,3 +10,30 @@ struct Collision_event {
 };
 
 void process_collision_event(Collision_event const &e);
+
+// Two armies without the local player ran into each other.
+struct Battle_event {
+    entt::registry *registry;
+    entt::entity first, second;
+};
+
+// Auto-resolves the battle; the routed army is destroyed.
+void process_battle_event(Battle_event const &e);
+
+// `seen` came into `viewer`'s view.
+struct Entered_view {
+    entt::registry *registry;
+    entt::entity viewer, seen;
+};
+
+// `seen` went out of `viewer`'s view, or stopped existing.
+struct Left_view {
+    entt::registry *registry;
+    entt::entity viewer, seen;
+};
+
+// AI armies reconsider what to do.
+void process_entered_view_event(Entered_view const &e);
+
+// Those chasing `seen` give up, and AI armies reconsider.
+void process_left_view_event(Left_view const &e);
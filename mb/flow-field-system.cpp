@@ -0,0 +1,57 @@
+#include <mb/components.h>
+#include <mb/flow-field.h>
+#include <mb/frame-arena.h>
+#include <mb/path-service.h>
+#include <mb/systems.h>
+#include <mb/thread-pool.h>
+
+#include <memory_resource>
+#include <optional>
+#include <unordered_map>
+
+/// @brief Keeps one flow field per entity being chased, for pathing_system.
+///
+/// A field is rebuilt only when its target moves to another cell, and dropped
+/// once nobody chases the target any more. Rebuilds run on `pool`.
+void flow_field_system(entt::registry &reg, Thread_pool &pool)
+{
+    auto &fields = reg.ctx().get<Flow_fields>();
+    auto const &grid = reg.ctx().get<Path_service>().grid();
+    auto &arena = reg.ctx().get<Frame_arena>();
+
+    std::pmr::unordered_map<entt::entity, Grid_cell> goals{&arena};
+    for (auto [e, pathing] : reg.view<Pathing>().each()) {
+        if (pathing.target_is_entity && reg.valid(pathing.dest_e) &&
+            reg.all_of<Position>(pathing.dest_e)) {
+            goals.try_emplace(
+                pathing.dest_e,
+                grid.cell_of(reg.get<Position>(pathing.dest_e).value));
+        }
+    }
+    std::erase_if(fields.by_target,
+                  [&](auto const &field) {
+                      return !goals.contains(field.first);
+                  });
+
+    struct Job {
+        entt::entity target;
+        Grid_cell goal;
+        std::optional<Flow_field> field;
+    };
+    std::pmr::vector<Job> jobs{&arena};
+    for (auto [target, goal] : goals) {
+        auto it = fields.by_target.find(target);
+        if (it == fields.by_target.end() || it->second.goal() != goal) {
+            jobs.push_back(Job{.target = target, .goal = goal, .field = {}});
+        }
+    }
+    pool.parallel_for(jobs.size(), 1, [&](std::size_t begin, std::size_t end) {
+        for (auto i = begin; i != end; ++i) {
+            jobs[i].field.emplace(grid, jobs[i].goal);
+        }
+    });
+    for (auto &job : jobs) {
+        fields.by_target.insert_or_assign(job.target, std::move(*job.field));
+    }
+    fields.builds += jobs.size();
+}
@@ -0,0 +1,90 @@
+#include <mb/flow-field.h>
+
+#include <algorithm>
+#include <array>
+#include <limits>
+
+namespace {
+
+constexpr std::array<Grid_cell, 8> neighbour_offsets{{
+    {.x = 1, .z = 0},
+    {.x = -1, .z = 0},
+    {.x = 0, .z = 1},
+    {.x = 0, .z = -1},
+    {.x = 1, .z = 1},
+    {.x = 1, .z = -1},
+    {.x = -1, .z = 1},
+    {.x = -1, .z = -1},
+}};
+
+constexpr std::int8_t at_goal{-1};
+constexpr std::int8_t unreachable{-2};
+
+} // namespace
+
+Flow_field::Flow_field(Nav_grid const &grid, Grid_cell goal)
+    : goal_{goal},
+      bounds_{.x0 = std::max(goal.x - radius, 0),
+              .z0 = std::max(goal.z - radius, 0),
+              .x1 = std::min(goal.x + radius + 1, grid.width()),
+              .z1 = std::min(goal.z + radius + 1, grid.depth())}
+{
+    auto costs = cost_field(grid, goal, bounds_);
+    auto width = bounds_.x1 - bounds_.x0;
+    auto cost_at = [&](Grid_cell c) {
+        return costs[((c.z - bounds_.z0) * width) + (c.x - bounds_.x0)];
+    };
+
+    steps_.resize(costs.size(), unreachable);
+    for (auto z = bounds_.z0; z != bounds_.z1; ++z) {
+        for (auto x = bounds_.x0; x != bounds_.x1; ++x) {
+            Grid_cell c{.x = x, .z = z};
+            auto &step = steps_[((z - bounds_.z0) * width) + (x - bounds_.x0)];
+            if (c == goal) {
+                step = at_goal;
+                continue;
+            }
+            if (cost_at(c) == std::numeric_limits<float>::infinity()) {
+                continue;
+            }
+            // Take the step that leaves the least cost to go, under the same
+            // rules as the search.
+            auto best = std::numeric_limits<float>::infinity();
+            for (std::size_t i{}; i != neighbour_offsets.size(); ++i) {
+                auto offset = neighbour_offsets[i];
+                Grid_cell n{.x = x + offset.x, .z = z + offset.z};
+                if (!bounds_.contains(n)) {
+                    continue;
+                }
+                auto cost = grid.step_cost(c, n);
+                if (!cost ||
+                    (offset.x != 0 && offset.z != 0 &&
+                     (!grid.step_cost(c, {.x = n.x, .z = z}) ||
+                      !grid.step_cost(c, {.x = x, .z = n.z})))) {
+                    continue;
+                }
+                if (*cost + cost_at(n) < best) {
+                    best = *cost + cost_at(n);
+                    step = static_cast<std::int8_t>(i);
+                }
+            }
+        }
+    }
+}
+
+std::optional<Grid_cell> Flow_field::next(Grid_cell c) const
+{
+    if (!bounds_.contains(c)) {
+        return std::nullopt;
+    }
+    auto step = steps_[((c.z - bounds_.z0) * (bounds_.x1 - bounds_.x0)) +
+                       (c.x - bounds_.x0)];
+    if (step == unreachable) {
+        return std::nullopt;
+    }
+    if (step == at_goal) {
+        return goal_;
+    }
+    auto offset = neighbour_offsets[static_cast<std::size_t>(step)];
+    return Grid_cell{.x = c.x + offset.x, .z = c.z + offset.z};
+}
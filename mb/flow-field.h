@@ -0,0 +1,47 @@
+#pragma once
+#include <mb/nav-grid.h>
+
+#include <cstdint>
+#include <entt/entt.hpp>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+/// @brief Where to step next, from any cell around a goal, to reach it
+/// cheapest.
+///
+/// Built with one Dijkstra search outwards from the goal over a square window,
+/// after which every follower finds its next cell with a single lookup
+/// however many there are.
+class Flow_field {
+  public:
+    // Cells of the window on each side of the goal; well beyond view_dist,
+    // since followers are those who can see the goal.
+    static constexpr int radius{32};
+
+    Flow_field(Nav_grid const &grid, Grid_cell goal);
+
+    [[nodiscard]] Grid_cell goal() const
+    {
+        return goal_;
+    }
+
+    // Next cell on the way from `c` to the goal, the goal itself once there;
+    // std::nullopt outside the window or where the goal can't be reached
+    // without leaving it.
+    [[nodiscard]] std::optional<Grid_cell> next(Grid_cell c) const;
+
+  private:
+    Grid_cell goal_;
+    Cell_rect bounds_;
+    // Per window cell, row by row: index of the neighbour offset to take, or
+    // one of the markers in flow-field.cpp.
+    std::vector<std::int8_t> steps_;
+};
+
+// Flow fields towards the entities being chased, kept by flow_field_system in
+// the registry's context.
+struct Flow_fields {
+    std::unordered_map<entt::entity, Flow_field> by_target;
+    std::size_t builds;
+};
@@ -0,0 +1,56 @@
+#include <mb/frame-arena.h>
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <new>
+
+Frame_arena::Frame_arena(std::size_t capacity)
+    : buffer_{std::make_unique_for_overwrite<std::byte[]>(capacity)},
+      capacity_{capacity}
+{
+}
+
+Frame_arena::~Frame_arena()
+{
+    free_overflow();
+}
+
+void *Frame_arena::do_allocate(std::size_t bytes, std::size_t alignment)
+{
+    auto base = reinterpret_cast<std::uintptr_t>(buffer_.get());
+    auto begin = ((base + used_ + alignment - 1) & ~(alignment - 1)) - base;
+    if (begin + bytes <= capacity_) {
+        used_ = begin + bytes;
+        return buffer_.get() + begin;
+    }
+    ++stats_.overflows;
+    auto *p = ::operator new(bytes, std::align_val_t{alignment});
+    overflow_.push_back(
+        Overflow{.p = p, .bytes = bytes, .alignment = alignment});
+    overflow_bytes_ += bytes;
+    return p;
+}
+
+void Frame_arena::reset()
+{
+    auto frame = used();
+    stats_.last_frame = frame;
+    stats_.high_water = std::max(stats_.high_water, frame);
+    if (!overflow_.empty()) {
+        free_overflow();
+        // Room for the whole frame, with slack for alignment.
+        capacity_ = std::bit_ceil(frame + (frame / 8));
+        buffer_ = std::make_unique_for_overwrite<std::byte[]>(capacity_);
+    }
+    used_ = 0;
+}
+
+void Frame_arena::free_overflow()
+{
+    for (auto const &o : overflow_) {
+        ::operator delete(o.p, o.bytes, std::align_val_t{o.alignment});
+    }
+    overflow_.clear();
+    overflow_bytes_ = 0;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+struct Frame_arena_stats {
+    std::size_t last_frame; // bytes handed out during the last frame
+    std::size_t high_water; // most bytes handed out during any one frame
+    std::size_t overflows;  // allocations that didn't fit the buffer
+};
+
+/// @brief Bump allocator for scratch data that lives no longer than a frame.
+///
+/// Allocating moves a pointer through one buffer and deallocating does
+/// nothing; everything is dropped at once by reset(), at the end of each
+/// frame. Use it through std::pmr containers. What doesn't fit the buffer
+/// comes from the heap, and the buffer grows at the next reset to hold the
+/// whole frame, so a steady frame stays inside it.
+///
+/// Lives in the registry's context. Frame thread only: jobs on the thread
+/// pool may use containers allocated here but not allocate from it.
+class Frame_arena : public std::pmr::memory_resource {
+  public:
+    explicit Frame_arena(std::size_t capacity = std::size_t{1} << 20U);
+    Frame_arena(Frame_arena const &) = delete;
+    Frame_arena(Frame_arena &&) = delete;
+    Frame_arena &operator=(Frame_arena const &) = delete;
+    Frame_arena &operator=(Frame_arena &&) = delete;
+    ~Frame_arena() override;
+
+    // Invalidates everything allocated since the last reset.
+    void reset();
+
+    [[nodiscard]] std::size_t used() const
+    {
+        return used_ + overflow_bytes_;
+    }
+    [[nodiscard]] std::size_t capacity() const
+    {
+        return capacity_;
+    }
+    [[nodiscard]] Frame_arena_stats stats() const
+    {
+        return stats_;
+    }
+
+  private:
+    struct Overflow {
+        void *p;
+        std::size_t bytes;
+        std::size_t alignment;
+    };
+
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(void * /*p*/, std::size_t /*bytes*/,
+                       std::size_t /*alignment*/) override
+    {
+    }
+    [[nodiscard]] bool
+    do_is_equal(std::pmr::memory_resource const &other) const noexcept override
+    {
+        return this == &other;
+    }
+    void free_overflow();
+
+    std::unique_ptr<std::byte[]> buffer_;
+    std::size_t capacity_;
+    std::size_t used_{};
+    std::vector<Overflow> overflow_;
+    std::size_t overflow_bytes_{};
+    Frame_arena_stats stats_{};
+};
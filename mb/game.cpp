@@ -1,22 +1,53 @@
 #include <mb/game.h>
 
+#include <array>
 #include <imgui.h>
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_opengl3.h>
 #include <iostream>
+#include <mb/ai-scheduler.h>
 #include <mb/components.h>
 #include <mb/dialog.h>
+#include <mb/economy.h>
+#include <mb/entity-factory.h>
 #include <mb/events.h>
+#include <mb/flow-field.h>
 #include <mb/font.h>
+#include <mb/frame-arena.h>
 #include <mb/generate-mesh.h>
 #include <mb/get-terrain-height.h>
+#include <mb/height-field.h>
 #include <mb/helpers.h>
+#include <mb/hierarchy.h>
 #include <mb/lights.h>
 #include <mb/model.h>
+#include <mb/prototype-defs.h>
+#include <mb/random.h>
+#include <mb/resource-cache.h>
+#include <mb/small-vector.h>
+#include <mb/snapshot.h>
+#include <mb/spatial-order.h>
 #include <mb/systems.h>
 #include <mb/texture.h>
 #include <mb/town.h>
 #include <mb/troop.h>
+#include <stdexcept>
+
+namespace {
+
+// Same seed, same world: terrain, spawns and every AI decision.
+constexpr std::uint64_t world_seed{0x6D62'0000'0000'0001};
+
+// Sim_clock seconds between autosaves.
+constexpr double autosave_period{60};
+
+void log_small_vector_stats(std::string_view name, Small_vector_stats s)
+{
+    spdlog::info("{}: {} heap allocations, at most {} elements", name,
+                 s.allocations, s.largest);
+}
+
+} // namespace
 
 Game::Game(int width, int height)
     : width_{width}, height_{height},
@@ -37,15 +68,47 @@ void Game::init_world()
     auto &reg = registry_;
 
     reg.ctx().emplace<Game_state>(Game_state::Normal);
-
-    std::vector<Troop> troops;
-    troops.push_back({.armor = -1, .weapon_damage = -1});
-
-    auto cube = generate_cube_model();
-    auto [terrain_model, height_map] = generate_terrain_model(100, 100, 0.05F);
+    reg.ctx().emplace<Sim_clock>();
+    reg.ctx().emplace<Frame_arena>();
+    auto const &rng = reg.ctx().emplace<Random>(world_seed);
+    spdlog::info("World seed: {:#x}", rng.seed());
+    reg.on_construct<Ai_tag>().connect<&Ai_scheduler::track>(
+        reg.ctx().emplace<Ai_scheduler>());
+    track_world_matrices(reg);
+    reg.ctx().emplace<Hierarchy>().track(reg);
+
+    auto &factory = reg.ctx().emplace<Entity_factory>(reg);
+    auto cube = generate_cube_model(resources_);
+    Prototype_assets assets{
+        .model =
+            [&](std::string const &name) {
+                return name == "cube" ? cube : resources_.load_model(name);
+            },
+        .shader = [&](std::string const &name) -> Shader_program const * {
+            if (name == "main") {
+                return &shader_;
+            }
+            if (name == "light") {
+                return &light_cube_shader_;
+            }
+            spdlog::error("Unknown shader {}", name);
+            throw std::runtime_error("check last error");
+        }};
+    Prototype_defs::load("./prototypes/world.proto",
+                         "./prototypes/world.protobin")
+        .install(reg.ctx().emplace<Troop_roster>(), factory, assets);
+
+    auto [terrain_model, height_map] =
+        generate_terrain_model(resources_, 100, 100, 0.05F,
+                               rng.stream(Rng_domain::Terrain, 0U, 0));
     height_map_ = height_map;
-    auto vex = std::make_shared<Model>("./resources/vex.glb");
-    auto yen = std::make_shared<Model>("./resources/yen.glb");
+    reg.ctx().emplace<Height_field>(height_map_);
+    // Named in the cache so that snapshots can refer to it.
+    terrain_model = resources_.get_or_create_model(
+        "terrain", [&] { return terrain_model; });
+    reg.ctx().emplace<Path_service>(Nav_grid{height_map_}, workers_);
+    reg.ctx().emplace<Flow_fields>();
+    reg.ctx().emplace<Spatial_order>(workers_);
 
     // Init camere
     {
@@ -105,71 +168,50 @@ void Game::init_world()
                               .cut_off = glm::cos(glm::radians(12.F)),
                               .outer_cut_off = glm::cos(glm::radians(20.F))};
         reg.emplace<Spot_light>(e, spot_light);
-        reg.emplace<Position>(e, reg.get<Position>(fpscam));
+        // Follows the first person camera like a flashlight.
+        reg.emplace<Position>(e);
+        reg.emplace<Parent>(e, fpscam);
+        reg.emplace<Local_transform>(e);
         reg.emplace<Light>(e, Light{.ambient = glm::vec3{0.1},
                                     .diffuse = glm::vec3{0.8},
                                     .specular = glm::vec3{1}});
     }
 
     { // Init `me`
-        auto e = reg.create();
-        reg.emplace<Local_player_tag>(e);
-        glm::vec3 pos{28, get_terrain_height(height_map_, 28, 47), 47};
-        reg.emplace<Position>(e, pos);
-        reg.emplace<Velocity>(e, Velocity{.dir = {0., 0., 0.}, .speed = 25});
-        std::vector<Troop_stack> tss;
-        tss.push_back(Troop_stack{.size = 1, .troop_id = -1UZ});
-        Army army{.stacks = tss, .perception = {}, .money = 35};
-        reg.emplace<Army>(e, army);
-        reg.emplace<Collidable>(e);
-        Renderable renderable{.model = vex, .shader = &shader_};
-        reg.emplace<Renderable>(e, renderable);
-        reg.emplace<Transform>(e, Transform{.scale = glm::vec3(0.03)});
+        factory.spawn_n("player", 1, [&](entt::entity e, std::size_t) {
+            reg.get<Position>(e).value = {
+                28, get_terrain_height(height_map_, 28, 47), 47};
+        });
     }
 
     // Init armies
     {
-        std::random_device rd;
-        std::mt19937 gen(rd());
-
-        // 随机位置范围
-        std::uniform_real_distribution<float> pos_x(0, 100);
-        std::uniform_real_distribution<float> pos_z(0, 100);
-
-        // 随机队伍规模
-        std::uniform_int_distribution<int> troop_size(1, 5);
-
-        for (int i{}; i != 1; ++i) {
-            auto e = reg.create();
-            reg.emplace<Ai_tag>(e);
-            std::vector<Troop_stack> army;
-            std::size_t size = troop_size(gen);
-            army.push_back(Troop_stack{.size = size, .troop_id = -1UZ});
-            reg.emplace<Army>(e, Army{.stacks = army, .perception{}, .money{}});
-            reg.emplace<Collidable>(e);
-            glm::vec3 pos{pos_x(gen), 0, pos_z(gen)};
+        auto gen = rng.stream(Rng_domain::Spawn, 0U, 0);
+        factory.spawn_n("bandit", 1, [&](entt::entity e, std::size_t) {
+            // 随机队伍规模
+            auto size = static_cast<std::size_t>(gen.uniform_int(1, 5));
+            reg.get<Army>(e).stacks.front().size = size;
+            // 随机位置范围
+            glm::vec3 pos{gen.uniform(0, 100), 0, gen.uniform(0, 100)};
             pos.y = get_terrain_height(height_map_, pos.x, pos.z);
-            reg.emplace<Position>(e, pos);
-            reg.emplace<Velocity>(e, Velocity{.dir = {}, .speed = 20.0f});
-            Renderable renderable{.model = yen, .shader = &shader_};
-            reg.emplace<Renderable>(e, renderable);
-            reg.emplace<Transform>(e, Transform{.scale = glm::vec3(0.03)});
-        }
+            reg.get<Position>(e).value = pos;
+        });
     }
     { // Init towns
-        auto e = reg.create();
-        reg.emplace<comp::Town_tag>(e);
-        reg.emplace<Collidable>(e);
-        auto apple = reg.create();
-        reg.emplace<comp::Item>(apple, comp::Item{.name{"Apple"}, .price{10}});
-        auto sub = reg.create();
-        reg.emplace<comp::Item>(sub,
-                                comp::Item{.name{"Subject"}, .price{1000}});
-        reg.emplace<comp::Market>(e, comp::Market{.items{apple, sub}});
+        comp::Market market{.items{factory.make_entity("apple"),
+                                   factory.make_entity("subject")}};
+        std::vector<Good> goods;
+        for (auto item : market.items) {
+            auto const &[name, price] = reg.get<comp::Item>(item);
+            goods.push_back(Good{.name = name, .base_price = price});
+        }
+        auto &economy = reg.ctx().emplace<Economy>(std::move(goods), workers_);
+        auto e = factory.make_entity("town");
+        reg.emplace<comp::Market>(e, market);
         Position pos{.value{30, get_terrain_height(height_map_, 30, 40), 40}};
-        reg.emplace<Position>(e, pos);
-        reg.emplace<Renderable>(e, Renderable{.model{cube}, .shader{&shader_}});
-        reg.emplace<Transform>(e, Transform{.scale = glm::vec3(8)});
+        reg.get<Position>(e) = pos;
+        economy.add_town(e, pos.value, std::array{36.0F, 1.0F},
+                         std::array{35.0F, 1.2F});
     }
 
     { // Init terrain
@@ -178,6 +220,122 @@ void Game::init_world()
             e, Renderable{.model = terrain_model, .shader = &shader_});
         reg.emplace<Position>(e, glm::vec3{0.0F, 0.0F, 0.0F});
     }
+
+    { // Init snapshots
+        Snapshot_schema schema;
+        schema.component<Position>("Position")
+            .component<Velocity>("Velocity")
+            .component<Transform>("Transform")
+            .component<View_mode>("View_mode")
+            .component<Fps_camemra_tag>("Fps_camera_tag")
+            .component<Local_player_tag>("Local_player_tag")
+            .component<Ai_tag>("Ai_tag")
+            .component<Ai_cooldown>("Ai_cooldown")
+            .component<Collidable>("Collidable")
+            .component<Light>("Light")
+            .component<Directional_light>("Directional_light")
+            .component<Point_light>("Point_light")
+            .component<Spot_light>("Spot_light")
+            .component<Parent>("Parent")
+            .component<Local_transform>("Local_transform")
+            .component<comp::Town_tag>("Town_tag");
+        // Perception refills visibility and AI re-plans its paths, so only
+        // what they can't rebuild is saved.
+        schema.component<Army>(
+            "Army",
+            [](Snapshot_writer &out, Army const &army) {
+                out.varint(army.stacks.size());
+                for (auto const &stack : army.stacks) {
+                    out.varint(stack.size);
+                    out.varint(stack.troop_id);
+                }
+                out.raw(army.money);
+            },
+            [](Snapshot_reader &in) {
+                Army army{.stacks{}, .perception{}, .money{}};
+                for (auto stacks = in.varint(); stacks != 0; --stacks) {
+                    auto size = in.varint();
+                    army.stacks.push_back(
+                        Troop_stack{.size = size, .troop_id = in.varint()});
+                }
+                army.money = in.raw<float>();
+                return army;
+            });
+        // Camera has padding, which mustn't end up in saves.
+        schema.component<Camera>(
+            "Camera",
+            [](Snapshot_writer &out, Camera const &cam) {
+                out.raw(cam.yaw);
+                out.raw(cam.pitch);
+                out.varint(cam.is_active ? 1 : 0);
+            },
+            [](Snapshot_reader &in) {
+                return Camera{.yaw = in.raw<float>(),
+                              .pitch = in.raw<float>(),
+                              .is_active = in.varint() != 0};
+            });
+        schema.component<Visibility>(
+            "Visibility", [](Snapshot_writer &, Visibility const &) {},
+            [](Snapshot_reader &) { return Visibility{}; });
+        schema.component<comp::Item>(
+            "Item",
+            [](Snapshot_writer &out, comp::Item const &item) {
+                out.string(item.name);
+                out.raw(item.price);
+            },
+            [](Snapshot_reader &in) {
+                auto name = in.string();
+                return comp::Item{.name = std::move(name),
+                                  .price = in.raw<float>()};
+            });
+        schema.component<comp::Market>(
+            "Market",
+            [](Snapshot_writer &out, comp::Market const &market) {
+                out.varint(market.items.size());
+                for (auto item : market.items) {
+                    out.entity(item);
+                }
+            },
+            [](Snapshot_reader &in) {
+                comp::Market market;
+                for (auto items = in.varint(); items != 0; --items) {
+                    market.items.push_back(in.entity());
+                }
+                return market;
+            });
+        // Models by their key in the cache; generated ones must have been
+        // generated again before loading.
+        schema.component<Renderable>(
+            "Renderable",
+            [this](Snapshot_writer &out, Renderable const &renderable) {
+                out.string(resources_.key_of(renderable.model.get()));
+                out.string(renderable.shader == &light_cube_shader_ ? "light"
+                                                                    : "main");
+            },
+            [this, shader = assets.shader](Snapshot_reader &in) {
+                auto key = in.string();
+                constexpr std::string_view generated{"generated:"};
+                auto model =
+                    key.starts_with(generated)
+                        ? resources_.get_or_create_model(
+                              key.substr(generated.size()),
+                              [&]() -> std::shared_ptr<Model> {
+                                  spdlog::error("Model {} isn't generated",
+                                                key);
+                                  throw std::runtime_error(
+                                      "check last error");
+                              })
+                        : resources_.load_model(key);
+                return Renderable{.model = model,
+                                  .shader = shader(in.string())};
+            });
+        schema.context<Game_state>("Game_state")
+            .context<Sim_clock>("Sim_clock");
+        reg.ctx().emplace<Snapshot_saver>(std::move(schema), "./saves",
+                                          workers_);
+    }
+
+    resources_.log_stats();
 }
 
 void Game::main_loop(GLFWwindow *window)
@@ -185,6 +343,9 @@ void Game::main_loop(GLFWwindow *window)
     double last_frame = glfwGetTime();
 
     dispatcher_.sink<Collision_event>().connect<process_collision_event>();
+    dispatcher_.sink<Entered_view>().connect<process_entered_view_event>();
+    dispatcher_.sink<Left_view>().connect<process_left_view_event>();
+    dispatcher_.sink<Battle_event>().connect<process_battle_event>();
 
     spdlog::info("Entering main loop...");
     // When send close command to window, glfwWindowShouldClose will return
@@ -216,7 +377,8 @@ void Game::main_loop(GLFWwindow *window)
             break;
         }
 
-        render_system(registry_, proj_);
+        world_matrix_system(registry_);
+        render_system(registry_, render_queue_, proj_);
         { // Show FPS
             // FIXME: This doesn't change when in dialog
             static double accumu{};
@@ -224,18 +386,29 @@ void Game::main_loop(GLFWwindow *window)
             static double fps = 0;
             if (accumu >= 1) {
                 fps = 1. / dt;
-                spdlog::trace("fps={}", fps);
+                auto arena = registry_.ctx().get<Frame_arena>().stats();
+                spdlog::trace("fps={} frame arena: {} bytes, peak {}", fps,
+                              arena.last_frame, arena.high_water);
                 accumu = 0;
             }
-            ui_.render_text(std::format("fps={:.0f}", fps), {0, 0}, 1,
-                            {1, 1, 1});
+            std::array<char, 16> label;
+            auto out = std::format_to_n(label.data(), label.size(),
+                                        "fps={:.0f}", fps);
+            ui_.render_text({label.data(), out.out}, {0, 0}, 1, {1, 1, 1});
         }
 
         ImGui::Render();
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
         glfwSwapBuffers(window);
+        registry_.ctx().get<Frame_arena>().reset();
     }
     spdlog::info("Exited from main loop");
+    auto arena = registry_.ctx().get<Frame_arena>().stats();
+    spdlog::info("Frame arena: peak {} bytes per frame, {} overflows",
+                 arena.high_water, arena.overflows);
+    log_small_vector_stats("Army stacks", Army_stacks::stats());
+    log_small_vector_stats("Armies in view", Army_list::stats());
+    log_small_vector_stats("Market items", Market_items::stats());
 }
 
 void Game::cursorpos_input(double xpos, double ypos)
@@ -450,6 +623,13 @@ void Game::key_input(int key, int scancode, int action, int mods)
     if (key == GLFW_KEY_P && action == GLFW_PRESS) {
         view_mode_ = static_cast<View_mode>(static_cast<int>(view_mode_) ^ 1);
     }
+    if (key == GLFW_KEY_F9 && action == GLFW_PRESS &&
+        registry_.ctx().get<Snapshot_saver>().load_latest(
+            registry_, [this] { reset_world_services(); })) {
+        next_autosave_ =
+            registry_.ctx().get<Sim_clock>().time + autosave_period;
+        return;
+    }
 
     static std::deque<bool> key_pressed(GLFW_KEY_LAST + 1);
     key_pressed[key] = action == GLFW_PRESS || action == GLFW_REPEAT;
@@ -497,16 +677,39 @@ void Game::key_input(int key, int scancode, int action, int mods)
     }
 }
 
+void Game::reset_world_services()
+{
+    auto &ctx = registry_.ctx();
+    ctx.get<Ai_scheduler>().clear();
+    ctx.get<Flow_fields>().by_target.clear();
+    ctx.get<Spatial_order>().reset();
+    ctx.get<Economy>().reset();
+}
+
 void Game::normal(GLFWwindow *window, float dt)
 {
+    auto &clock = registry_.ctx().get<Sim_clock>();
+    ++clock.tick;
+    clock.time += dt;
+
     camera_script(registry_, window, view_mode_);
     town_script(registry_, dt);
-    perception_system(registry_);
-    ai_system(registry_, dt);
+    economy_system(registry_);
+    perception_system(registry_, dispatcher_);
+    ai_system(registry_);
+    flow_field_system(registry_, workers_);
     pathing_system(registry_);
-    movement_system(registry_, dt, height_map_);
+    movement_system(registry_, workers_, dt);
+    registry_.ctx().get<Hierarchy>().propagate(registry_);
+    animation_system(registry_, workers_, dt);
     collision_system(registry_, dispatcher_, dt);
     collision_script(registry_, dispatcher_);
+    registry_.ctx().get<Spatial_order>().step(registry_);
+
+    if (clock.time >= next_autosave_ &&
+        registry_.ctx().get<Snapshot_saver>().save(registry_, clock.tick)) {
+        next_autosave_ = clock.time + autosave_period;
+    }
 }
 
 void Game::in_dialog(GLFWwindow *window)
@@ -515,12 +718,19 @@ void Game::in_dialog(GLFWwindow *window)
     for (auto [e, dialog] : dialogs.each()) {
         ImGui::Begin("dialog : ");
         ImGui::Text("%s", dialog.scripts[0].c_str());
+        // An action may remove the Dialog, options included.
+        auto acted = false;
         for (auto const &option : dialog.options) {
             if (ImGui::Button(option.reply.c_str())) {
                 option.action();
+                acted = true;
+                break;
             }
         }
         ImGui::End();
+        if (acted) {
+            break;
+        }
     }
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_CAPTURED);
 }
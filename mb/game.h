@@ -1,7 +1,11 @@
 #pragma once
 #include <mb/font.h>
+#include <mb/render-queue.h>
+#include <mb/resource-cache.h>
 #include <mb/shader-program.h>
+#include <mb/thread-pool.h>
 
+#include <cstdint>
 #include <entt/entt.hpp>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
@@ -10,6 +14,12 @@ enum class View_mode { God, First_player };
 
 enum class Game_state { Normal, In_dialog, Should_exit };
 
+// Simulation time, advanced only while the game is running normally.
+struct Sim_clock {
+    std::uint64_t tick;
+    double time; // seconds
+};
+
 class Game {
   public:
     Game(int width, int height);
@@ -33,6 +43,9 @@ class Game {
 
     void normal(GLFWwindow *window, float dt);
     void in_dialog(GLFWwindow *window);
+    // Drops what services in the registry's context keep about the world,
+    // before a snapshot replaces it.
+    void reset_world_services();
 
     int width_;
     int height_;
@@ -42,8 +55,12 @@ class Game {
     Shader_program shader_;
     Shader_program light_cube_shader_;
     Shader_program font_shader_;
+    // Declared before registry_ so that it outlives every Renderable.
+    Resource_cache resources_;
     entt::registry registry_;
     entt::dispatcher dispatcher_;
+    Render_queue render_queue_;
+    Thread_pool workers_;
 
     std::vector<std::vector<float>> height_map_;
 
@@ -51,4 +68,5 @@ class Game {
     Ui ui_;
 
     View_mode view_mode_{View_mode::God};
+    double next_autosave_{}; // Sim_clock time
 };
@@ -2,19 +2,21 @@
 
 #include <mb/model.h>
 #include <mb/perlin.h>
+#include <mb/resource-cache.h>
 
 #include <glm/glm.hpp>
 #include <memory>
 #include <vector>
 
 std::pair<std::shared_ptr<Model>, std::vector<std::vector<float>>>
-generate_terrain_model(int width, int depth, float scale)
+generate_terrain_model(Resource_cache &cache, int width, int depth,
+                       float scale, Random_stream rng)
 {
-    Perlin perlin;
+    Perlin perlin{rng};
     std::vector<Vertex> vertices;
     std::vector<std::uint32_t> indices;
-    Texture diffuse("./resources/wjz.jpg");
-    Texture specular("./resources/wjz.jpg");
+    auto diffuse = cache.load_texture("./resources/wjz.jpg");
+    auto specular = cache.load_texture("./resources/wjz.jpg");
 
     int rows = depth;
     int cols = width;
@@ -98,13 +100,15 @@ generate_terrain_model(int width, int depth, float scale)
         }
     }
 
-    return std::make_pair(std::make_shared<Model>(vertices, indices,
+    // Every terrain is generated from fresh noise, so it is never shared
+    // through the cache; only its textures are.
+    return std::make_pair(std::make_shared<Model>(cache, vertices, indices,
                                                   std::move(diffuse),
                                                   std::move(specular)),
                           height);
 }
 
-std::shared_ptr<Model> generate_cube_model()
+std::shared_ptr<Model> generate_cube_model(Resource_cache &cache)
 {
     std::vector<Vertex> vertices{// Back face (z = -0.5)
                                  {.position = {-0.5f, -0.5f, -0.5f},
@@ -227,8 +231,9 @@ std::shared_ptr<Model> generate_cube_model()
                                   .texcoord = {0.0f, 1.0f}}};
     std::vector<std::uint32_t> indices(vertices.size());
     std::ranges::iota(indices, 0);
-    Texture diffuse("./resources/wjz.jpg");
-    Texture specular("./resources/wjz.jpg");
-    return std::make_shared<Model>(vertices, indices, std::move(diffuse),
-                                   std::move(specular));
+    return cache.get_or_create_model("cube", [&]() {
+        return std::make_shared<Model>(
+            cache, vertices, indices, cache.load_texture("./resources/wjz.jpg"),
+            cache.load_texture("./resources/wjz.jpg"));
+    });
 }
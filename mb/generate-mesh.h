@@ -1,12 +1,15 @@
 #pragma once
 #include <mb/mesh.h>
+#include <mb/random.h>
 
 #include <memory>
 #include <numeric>
 
 class Model;
+class Resource_cache;
 
 std::pair<std::shared_ptr<Model>, std::vector<std::vector<float>>>
-generate_terrain_model(int width, int depth, float scale);
+generate_terrain_model(Resource_cache &cache, int width, int depth,
+                       float scale, Random_stream rng);
 
-std::shared_ptr<Model> generate_cube_model();
+std::shared_ptr<Model> generate_cube_model(Resource_cache &cache);
@@ -0,0 +1,218 @@
+#include <mb/geometry-arena.h>
+
+#include <mb/check-gl-errors.h>
+
+#include <algorithm>
+#include <cassert>
+#include <spdlog/spdlog.h>
+#include <utility>
+
+namespace {
+
+constexpr std::size_t initial_vertices{1UZ << 16};
+constexpr std::size_t initial_indices{1UZ << 18};
+
+// Reallocates `buffer` with room for `new_size` bytes and keeps the first
+// `old_size` bytes. Returns the new buffer name.
+GLuint reallocate(GLuint buffer, std::size_t old_size, std::size_t new_size)
+{
+    GLuint grown;
+    glCreateBuffers(1, &grown);
+    glNamedBufferData(grown, static_cast<GLsizeiptr>(new_size), nullptr,
+                      GL_STATIC_DRAW);
+    if (buffer != 0) {
+        glCopyNamedBufferSubData(buffer, grown, 0, 0,
+                                 static_cast<GLsizeiptr>(old_size));
+        glDeleteBuffers(1, &buffer);
+    }
+    check_gl_errors();
+    return grown;
+}
+
+} // namespace
+
+Range_allocator::Range_allocator(std::size_t capacity) : capacity_{capacity}
+{
+    if (capacity != 0) {
+        free_.insert({0, capacity});
+    }
+}
+
+std::optional<std::size_t> Range_allocator::allocate(std::size_t count)
+{
+    for (auto it = free_.begin(); it != free_.end(); ++it) {
+        auto [offset, size] = *it;
+        if (size < count) {
+            continue;
+        }
+        free_.erase(it);
+        if (size > count) {
+            free_.insert({offset + count, size - count});
+        }
+        used_ += count;
+        return offset;
+    }
+    return std::nullopt;
+}
+
+void Range_allocator::free(std::size_t offset, std::size_t count)
+{
+    assert(offset + count <= capacity_);
+    used_ -= count;
+    auto [it, inserted] = free_.insert({offset, count});
+    assert(inserted && "double free");
+
+    // Merge with the following block
+    if (auto next = std::next(it);
+        next != free_.end() && it->first + it->second == next->first) {
+        it->second += next->second;
+        free_.erase(next);
+    }
+    // Merge with the preceding block
+    if (it != free_.begin()) {
+        auto prev = std::prev(it);
+        if (prev->first + prev->second == it->first) {
+            prev->second += it->second;
+            free_.erase(it);
+        }
+    }
+}
+
+void Range_allocator::grow(std::size_t new_capacity)
+{
+    assert(new_capacity >= capacity_);
+    auto old_capacity = std::exchange(capacity_, new_capacity);
+    used_ += new_capacity - old_capacity;
+    free(old_capacity, new_capacity - old_capacity);
+}
+
+Geometry_arena::~Geometry_arena()
+{
+    for (auto &pool : pools_) {
+        glDeleteVertexArrays(1, &pool.vao);
+        glDeleteBuffers(1, &pool.vbo);
+        glDeleteBuffers(1, &pool.ebo);
+    }
+}
+
+Geometry_range Geometry_arena::allocate(Vertex_layout layout,
+                                        std::span<std::byte const> vertices,
+                                        std::span<std::byte const> indices)
+{
+    auto &pool = pool_of(layout);
+    auto stride = static_cast<std::size_t>(layout.stride());
+    auto index_size = layout.index_size();
+    assert(vertices.size() % stride == 0);
+    assert(indices.size() % index_size == 0);
+    auto vertex_count = vertices.size() / stride;
+    auto index_count = indices.size() / index_size;
+
+    auto vertex_offset = pool.vertices.allocate(vertex_count);
+    if (!vertex_offset) {
+        grow_vertices(pool, pool.vertices.capacity() + vertex_count);
+        vertex_offset = pool.vertices.allocate(vertex_count);
+    }
+    auto index_offset = pool.indices.allocate(index_count);
+    if (!index_offset) {
+        grow_indices(pool, pool.indices.capacity() + index_count);
+        index_offset = pool.indices.allocate(index_count);
+    }
+    assert(vertex_offset && index_offset);
+
+    glNamedBufferSubData(pool.vbo,
+                         static_cast<GLintptr>(*vertex_offset * stride),
+                         static_cast<GLsizeiptr>(vertices.size()),
+                         vertices.data());
+    glNamedBufferSubData(pool.ebo,
+                         static_cast<GLintptr>(*index_offset * index_size),
+                         static_cast<GLsizeiptr>(indices.size()),
+                         indices.data());
+    check_gl_errors();
+
+    return Geometry_range{.layout = layout,
+                          .base_vertex = static_cast<GLint>(*vertex_offset),
+                          .vertex_count = static_cast<GLuint>(vertex_count),
+                          .first_index = static_cast<GLuint>(*index_offset),
+                          .index_count = static_cast<GLuint>(index_count)};
+}
+
+void Geometry_arena::free(Geometry_range const &range)
+{
+    auto &pool = pool_of(range.layout);
+    pool.vertices.free(range.base_vertex, range.vertex_count);
+    pool.indices.free(range.first_index, range.index_count);
+}
+
+GLuint Geometry_arena::vao(Vertex_layout layout) const
+{
+    auto const *pool = find_pool(layout);
+    assert(pool != nullptr && "no mesh has been allocated with this layout");
+    return pool->vao;
+}
+
+void Geometry_arena::log_stats() const
+{
+    for (auto const &pool : pools_) {
+        spdlog::info("Geometry pool vao={} stride={}: {}/{} vertices, {}/{} "
+                     "indices",
+                     pool.vao, pool.layout.stride(), pool.vertices.used(),
+                     pool.vertices.capacity(), pool.indices.used(),
+                     pool.indices.capacity());
+    }
+}
+
+Geometry_arena::Pool &Geometry_arena::pool_of(Vertex_layout layout)
+{
+    auto it = std::ranges::find(pools_, layout, &Pool::layout);
+    if (it != pools_.end()) {
+        return *it;
+    }
+
+    Pool pool{.layout = layout,
+              .vao = 0,
+              .vbo = 0,
+              .ebo = 0,
+              .vertices = Range_allocator{0},
+              .indices = Range_allocator{0}};
+    glCreateVertexArrays(1, &pool.vao);
+    setup_vertex_attributes(pool.vao, layout);
+    grow_vertices(pool, initial_vertices);
+    grow_indices(pool, initial_indices);
+    spdlog::debug("Created geometry pool vao={} stride={}", pool.vao,
+                  layout.stride());
+    return pools_.emplace_back(std::move(pool));
+}
+
+Geometry_arena::Pool const *
+Geometry_arena::find_pool(Vertex_layout layout) const
+{
+    auto it = std::ranges::find(pools_, layout, &Pool::layout);
+    return it == pools_.end() ? nullptr : &*it;
+}
+
+void Geometry_arena::grow_vertices(Pool &pool, std::size_t min_capacity)
+{
+    auto stride = static_cast<std::size_t>(pool.layout.stride());
+    auto old_capacity = pool.vertices.capacity();
+    auto new_capacity = std::max(min_capacity, old_capacity * 2);
+    spdlog::debug("Growing vbo of vao {} to {} vertices", pool.vao,
+                  new_capacity);
+    pool.vbo = reallocate(pool.vbo, old_capacity * stride,
+                          new_capacity * stride);
+    pool.vertices.grow(new_capacity);
+    glVertexArrayVertexBuffer(pool.vao, 0, pool.vbo, 0,
+                              pool.layout.stride());
+}
+
+void Geometry_arena::grow_indices(Pool &pool, std::size_t min_capacity)
+{
+    auto index_size = pool.layout.index_size();
+    auto old_capacity = pool.indices.capacity();
+    auto new_capacity = std::max(min_capacity, old_capacity * 2);
+    spdlog::debug("Growing ebo of vao {} to {} indices", pool.vao,
+                  new_capacity);
+    pool.ebo = reallocate(pool.ebo, old_capacity * index_size,
+                          new_capacity * index_size);
+    pool.indices.grow(new_capacity);
+    glVertexArrayElementBuffer(pool.vao, pool.ebo);
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <mb/vertex-format.h>
+
+#include <cstddef>
+#include <glad/gl.h>
+#include <map>
+#include <optional>
+#include <span>
+#include <vector>
+
+// First-fit allocator over an abstract range of elements, coalescing freed
+// neighbours. Knows nothing about GL.
+class Range_allocator {
+  public:
+    explicit Range_allocator(std::size_t capacity);
+
+    std::optional<std::size_t> allocate(std::size_t count);
+    void free(std::size_t offset, std::size_t count);
+    // Extends the range; the new tail becomes free.
+    void grow(std::size_t new_capacity);
+
+    [[nodiscard]] std::size_t capacity() const
+    {
+        return capacity_;
+    }
+    [[nodiscard]] std::size_t used() const
+    {
+        return used_;
+    }
+
+  private:
+    std::size_t capacity_;
+    std::size_t used_{};
+    std::map<std::size_t, std::size_t> free_; // offset -> count
+};
+
+// Where a mesh lives inside the arena. Laid out so that it can be turned into
+// a DrawElementsIndirectCommand directly.
+struct Geometry_range {
+    Vertex_layout layout;
+    GLint base_vertex;
+    GLuint vertex_count;
+    GLuint first_index;
+    GLuint index_count;
+};
+
+/// @brief Suballocates every static mesh from a few large buffers: one vbo,
+/// ebo and vao per vertex layout.
+///
+/// Meshes sharing a layout can therefore be drawn with one vao bind and one
+/// glMultiDrawElementsIndirect. Buffers grow by doubling; their names may
+/// change when they do, but vao names never change.
+class Geometry_arena {
+  public:
+    Geometry_arena() = default;
+    Geometry_arena(Geometry_arena const &) = delete;
+    Geometry_arena(Geometry_arena &&) = delete;
+    Geometry_arena &operator=(Geometry_arena const &) = delete;
+    Geometry_arena &operator=(Geometry_arena &&) = delete;
+    ~Geometry_arena();
+
+    Geometry_range allocate(Vertex_layout layout,
+                            std::span<std::byte const> vertices,
+                            std::span<std::byte const> indices);
+    void free(Geometry_range const &range);
+
+    [[nodiscard]] GLuint vao(Vertex_layout layout) const;
+
+    void log_stats() const;
+
+  private:
+    struct Pool {
+        Vertex_layout layout;
+        GLuint vao;
+        GLuint vbo;
+        GLuint ebo;
+        Range_allocator vertices;
+        Range_allocator indices;
+    };
+
+    Pool &pool_of(Vertex_layout layout);
+    [[nodiscard]] Pool const *find_pool(Vertex_layout layout) const;
+    static void grow_vertices(Pool &pool, std::size_t min_capacity);
+    static void grow_indices(Pool &pool, std::size_t min_capacity);
+
+    // A handful of layouts at most, so a linear search is fine.
+    std::vector<Pool> pools_;
+};
@@ -0,0 +1,53 @@
+#include <mb/height-field.h>
+
+#include <algorithm>
+#include <cmath>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+
+namespace {
+
+// Entities stand this far above the ground.
+constexpr float clearance{2};
+
+} // namespace
+
+Height_field::Height_field(std::vector<std::vector<float>> const &rows)
+    : width_{rows.empty() ? 0 : static_cast<int>(rows[0].size())},
+      depth_{static_cast<int>(rows.size())}
+{
+    if (width_ == 0 || depth_ == 0) {
+        spdlog::error("Height_field: empty height map");
+        throw std::runtime_error("check last error");
+    }
+    heights_.reserve(static_cast<std::size_t>(width_) * depth_);
+    for (auto const &row : rows) {
+        heights_.insert(heights_.end(), row.begin(), row.end());
+    }
+}
+
+float Height_field::height_at(float x, float z) const
+{
+    float height{};
+    sample({&x, 1}, {&z, 1}, {&height, 1});
+    return height;
+}
+
+void Height_field::sample(std::span<float const> x, std::span<float const> z,
+                          std::span<float> heights) const
+{
+    auto const *h = heights_.data();
+    for (std::size_t i{}; i != heights.size(); ++i) {
+        auto fx = std::floor(x[i]);
+        auto fz = std::floor(z[i]);
+        auto t = x[i] - fx;
+        auto u = z[i] - fz;
+        auto x0 = std::clamp(static_cast<int>(fx), 0, width_ - 1);
+        auto x1 = std::clamp(static_cast<int>(fx) + 1, 0, width_ - 1);
+        auto z0 = std::clamp(static_cast<int>(fz), 0, depth_ - 1) * width_;
+        auto z1 = std::clamp(static_cast<int>(fz) + 1, 0, depth_ - 1) * width_;
+        heights[i] = ((1 - t) * (1 - u) * h[z0 + x0]) +
+                     (t * (1 - u) * h[z0 + x1]) + ((1 - t) * u * h[z1 + x0]) +
+                     (t * u * h[z1 + x1]) + clearance;
+    }
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <span>
+#include <vector>
+
+/// @brief Terrain heights on a grid with one sample per world unit, stored
+/// as one flat array.
+///
+/// Heights between samples are interpolated bilinearly; positions off the
+/// grid take the nearest edge. Like get_terrain_height, which it replaces
+/// for bulk lookups, it answers with the height entities stand at, two
+/// units above the ground.
+///
+/// Lives in the registry's context.
+class Height_field {
+  public:
+    // `rows[z][x]`, as generate_terrain_model makes them.
+    explicit Height_field(std::vector<std::vector<float>> const &rows);
+
+    [[nodiscard]] float height_at(float x, float z) const;
+
+    // heights[i] = height_at(x[i], z[i]). The loop has no branches, so it
+    // vectorizes where the target has gathers.
+    void sample(std::span<float const> x, std::span<float const> z,
+                std::span<float> heights) const;
+
+  private:
+    int width_;
+    int depth_;
+    std::vector<float> heights_; // row by row
+};
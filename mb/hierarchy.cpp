@@ -0,0 +1,172 @@
+#include <mb/hierarchy.h>
+
+#include <mb/components.h>
+
+#include <algorithm>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+namespace {
+
+constexpr glm::vec3 forward{1, 0, 0};
+
+// Depth of children whose chain ends at something that can't be a root.
+constexpr std::uint32_t orphan{~std::uint32_t{}};
+
+glm::quat orientation_of(entt::registry const &registry, entt::entity e)
+{
+    if (auto const *cam = registry.try_get<Camera>(e)) {
+        // Turns +X into Camera::front().
+        return glm::angleAxis(cam->yaw, glm::vec3{0, 1, 0}) *
+               glm::angleAxis(cam->pitch, glm::vec3{0, 0, 1});
+    }
+    if (auto const *trans = registry.try_get<Transform>(e)) {
+        auto rotx = glm::angleAxis(trans->rotation.x, glm::vec3{1, 0, 0});
+        auto roty = glm::angleAxis(trans->rotation.y, glm::vec3{0, 1, 0});
+        auto rotz = glm::angleAxis(trans->rotation.z, glm::vec3{0, 0, 1});
+        return rotz * roty * rotx;
+    }
+    return glm::quat{1, 0, 0, 0};
+}
+
+} // namespace
+
+void Hierarchy::track(entt::registry &registry)
+{
+    registry.on_construct<Parent>().connect<&Hierarchy::invalidate>(*this);
+    registry.on_update<Parent>().connect<&Hierarchy::invalidate>(*this);
+    registry.on_destroy<Parent>().connect<&Hierarchy::invalidate>(*this);
+    registry.on_construct<Local_transform>().connect<&Hierarchy::invalidate>(
+        *this);
+    registry.on_update<Local_transform>().connect<&Hierarchy::invalidate>(
+        *this);
+    registry.on_destroy<Local_transform>().connect<&Hierarchy::invalidate>(
+        *this);
+}
+
+void Hierarchy::invalidate(entt::registry & /*registry*/, entt::entity /*e*/)
+{
+    stale_ = true;
+}
+
+void Hierarchy::rebuild(entt::registry &registry)
+{
+    stale_ = false;
+    nodes_.clear();
+
+    auto children = registry.view<Parent, Local_transform>();
+    std::unordered_map<entt::entity, std::uint32_t> depths;
+    std::vector<entt::entity> roots;
+    std::vector<entt::entity> chain;
+    for (auto e : children) {
+        // Walks up to the first ancestor whose depth is known.
+        chain.clear();
+        auto at = e;
+        std::uint32_t depth{};
+        for (;;) {
+            if (auto it = depths.find(at); it != depths.end()) {
+                depth = it->second;
+                break;
+            }
+            if (!children.contains(at)) {
+                depth = registry.valid(at) && registry.all_of<Position>(at)
+                            ? 0
+                            : orphan;
+                if (depth == 0) {
+                    roots.push_back(at);
+                }
+                break;
+            }
+            if (chain.size() == children.size_hint()) {
+                spdlog::error("Hierarchy: entity {} is its own ancestor",
+                              static_cast<int>(e));
+                throw std::logic_error("check last error");
+            }
+            chain.push_back(at);
+            at = children.get<Parent>(at).entity;
+        }
+        for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+            depth = depth == orphan ? orphan : depth + 1;
+            depths.emplace(*it, depth);
+        }
+    }
+
+    std::ranges::sort(roots);
+    auto [last, end] = std::ranges::unique(roots);
+    roots.erase(last, end);
+    std::vector<std::pair<std::uint32_t, entt::entity>> order;
+    order.reserve(depths.size());
+    for (auto [e, depth] : depths) {
+        if (depth != orphan) {
+            order.emplace_back(depth, e);
+        }
+    }
+    std::ranges::sort(order);
+
+    // Every node moves in the coming sweep.
+    auto moved = sweep_ + 1;
+    std::unordered_map<entt::entity, std::uint32_t> index;
+    nodes_.reserve(roots.size() + order.size());
+    for (auto e : roots) {
+        index.emplace(e, static_cast<std::uint32_t>(nodes_.size()));
+        nodes_.push_back(
+            Node{.entity = e, .parent = no_parent, .local{}, .moved = moved});
+    }
+    roots_ = roots.size();
+    for (auto [depth, e] : order) {
+        index.emplace(e, static_cast<std::uint32_t>(nodes_.size()));
+        nodes_.push_back(
+            Node{.entity = e,
+                 .parent = index.at(children.get<Parent>(e).entity),
+                 .local = children.get<Local_transform>(e),
+                 .moved = moved});
+        registry.get_or_emplace<Position>(e);
+    }
+    spdlog::debug("Hierarchy: {} roots, {} children", roots_,
+                  nodes_.size() - roots_);
+}
+
+void Hierarchy::propagate(entt::registry &registry)
+{
+    if (stale_) {
+        rebuild(registry);
+    }
+    ++sweep_;
+
+    for (std::size_t i{}; i != roots_; ++i) {
+        auto &root = nodes_[i];
+        // Destroying an entity doesn't tell its children.
+        if (!registry.valid(root.entity) ||
+            !registry.all_of<Position>(root.entity)) {
+            stale_ = true;
+            propagate(registry);
+            return;
+        }
+        auto position = registry.get<Position>(root.entity).value;
+        auto rotation = orientation_of(registry, root.entity);
+        if (position != root.position || rotation != root.rotation) {
+            root.position = position;
+            root.rotation = rotation;
+            root.moved = sweep_;
+        }
+    }
+
+    for (auto i = roots_; i != nodes_.size(); ++i) {
+        auto &node = nodes_[i];
+        auto const &parent = nodes_[node.parent];
+        if (node.moved != sweep_ && parent.moved != sweep_) {
+            continue;
+        }
+        node.moved = sweep_;
+        node.position = parent.position + (parent.rotation * node.local.offset);
+        node.rotation = parent.rotation * node.local.rotation;
+        registry.patch<Position>(node.entity, [&](Position &pos) {
+            pos.value = node.position;
+        });
+        if (auto *light = registry.try_get<Spot_light>(node.entity)) {
+            light->dir = node.rotation * forward;
+        }
+    }
+}
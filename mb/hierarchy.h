@@ -0,0 +1,75 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <entt/entt.hpp>
+#include <glm/ext.hpp>
+#include <glm/glm.hpp>
+#include <vector>
+
+// Attaches an entity to `entity`, which places it through its
+// Local_transform.
+struct Parent {
+    entt::entity entity;
+};
+
+// Where a child sits in its parent's frame. Frames look down +X: a camera's
+// is turned by its yaw and pitch, others' by their Transform.
+struct Local_transform {
+    glm::vec3 offset{};
+    glm::quat rotation{1, 0, 0, 0};
+};
+
+/// @brief Keeps children where their Parent and Local_transform put them.
+///
+/// Nodes live in one flat array sorted by depth, roots first, and each knows
+/// its parent's index; a single forward sweep then reaches every parent
+/// before its children without looking anything up. Only roots are read
+/// from the registry each frame, and a subtree is worked out again only if
+/// its root moved or turned: children get their Position patched and their
+/// Spot_light, if any, aimed down their +X.
+///
+/// The array is rebuilt after a Parent or Local_transform is emplaced,
+/// patched or removed, and after a root is destroyed; children of a
+/// destroyed root stay where they are. Cycles throw.
+///
+/// Lives in the registry's context; see track().
+class Hierarchy {
+  public:
+    Hierarchy() = default;
+    Hierarchy(Hierarchy const &) = delete;
+    Hierarchy(Hierarchy &&) = delete;
+    Hierarchy &operator=(Hierarchy const &) = delete;
+    Hierarchy &operator=(Hierarchy &&) = delete;
+    ~Hierarchy() = default;
+
+    // Connects to the signals that make the array stale.
+    void track(entt::registry &registry);
+
+    // Moves the children of whatever moved since the last call.
+    void propagate(entt::registry &registry);
+
+    [[nodiscard]] std::size_t nodes() const
+    {
+        return nodes_.size();
+    }
+
+  private:
+    static constexpr std::uint32_t no_parent{~std::uint32_t{}};
+
+    struct Node {
+        entt::entity entity;
+        std::uint32_t parent; // into nodes_
+        Local_transform local;
+        glm::vec3 position{};
+        glm::quat rotation{1, 0, 0, 0};
+        std::uint64_t moved; // sweep it last moved in
+    };
+
+    void invalidate(entt::registry &registry, entt::entity e);
+    void rebuild(entt::registry &registry);
+
+    std::vector<Node> nodes_;
+    std::size_t roots_{}; // nodes_ starts with them
+    std::uint64_t sweep_{};
+    bool stale_{true};
+};
@@ -0,0 +1,228 @@
+#include <mb/mesh-optimizer.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <limits>
+#include <string_view>
+#include <unordered_map>
+
+namespace {
+
+constexpr auto invalid_index = std::numeric_limits<std::uint32_t>::max();
+
+struct Vertex_bytes_hash {
+    std::size_t operator()(Vertex const &v) const
+    {
+        return std::hash<std::string_view>{}(
+            {reinterpret_cast<char const *>(&v), sizeof(Vertex)});
+    }
+};
+
+struct Vertex_bytes_equal {
+    bool operator()(Vertex const &lhs, Vertex const &rhs) const
+    {
+        return std::memcmp(&lhs, &rhs, sizeof(Vertex)) == 0;
+    }
+};
+
+// Triangles touching each vertex, in compressed sparse row form.
+struct Adjacency {
+    std::vector<std::uint32_t> offsets;
+    std::vector<std::uint32_t> triangles;
+
+    [[nodiscard]] std::span<std::uint32_t const> of(std::uint32_t v) const
+    {
+        return std::span{triangles}.subspan(offsets[v],
+                                            offsets[v + 1] - offsets[v]);
+    }
+};
+
+Adjacency build_adjacency(std::span<std::uint32_t const> indices,
+                          std::size_t vertex_count)
+{
+    Adjacency adj;
+    adj.offsets.assign(vertex_count + 1, 0);
+    for (auto i : indices) {
+        ++adj.offsets[i + 1];
+    }
+    for (std::size_t v{}; v != vertex_count; ++v) {
+        adj.offsets[v + 1] += adj.offsets[v];
+    }
+    adj.triangles.resize(indices.size());
+    auto cursor = adj.offsets;
+    for (std::size_t i{}; i != indices.size(); ++i) {
+        adj.triangles[cursor[indices[i]]++] = static_cast<std::uint32_t>(i / 3);
+    }
+    return adj;
+}
+
+} // namespace
+
+float compute_acmr(std::span<std::uint32_t const> indices,
+                   std::size_t vertex_count, std::size_t cache_size)
+{
+    if (indices.size() < 3) {
+        return 0;
+    }
+    // A vertex is in the FIFO iff it was pushed less than cache_size pushes
+    // ago.
+    std::vector<std::size_t> pushed_at(vertex_count,
+                                       std::numeric_limits<std::size_t>::max());
+    std::size_t misses{};
+    for (auto i : indices) {
+        if (pushed_at[i] == std::numeric_limits<std::size_t>::max() ||
+            misses - pushed_at[i] >= cache_size) {
+            pushed_at[i] = misses++;
+        }
+    }
+    return static_cast<float>(misses) /
+           static_cast<float>(indices.size() / 3);
+}
+
+void weld_vertices(std::vector<Vertex> &vertices,
+                   std::span<std::uint32_t> indices)
+{
+    std::unordered_map<Vertex, std::uint32_t, Vertex_bytes_hash,
+                       Vertex_bytes_equal>
+        unique;
+    unique.reserve(vertices.size());
+    std::vector<std::uint32_t> remap(vertices.size());
+    std::vector<Vertex> welded;
+    welded.reserve(vertices.size());
+    for (std::size_t v{}; v != vertices.size(); ++v) {
+        auto [it, inserted] = unique.try_emplace(
+            vertices[v], static_cast<std::uint32_t>(welded.size()));
+        if (inserted) {
+            welded.push_back(vertices[v]);
+        }
+        remap[v] = it->second;
+    }
+    for (auto &i : indices) {
+        i = remap[i];
+    }
+    vertices = std::move(welded);
+}
+
+void optimize_vertex_cache(std::span<std::uint32_t> indices,
+                           std::size_t vertex_count, std::size_t cache_size)
+{
+    assert(indices.size() % 3 == 0);
+    auto triangle_count = indices.size() / 3;
+    if (triangle_count == 0) {
+        return;
+    }
+
+    auto adj = build_adjacency(indices, vertex_count);
+    std::vector<std::uint32_t> live(vertex_count);
+    for (std::size_t v{}; v != vertex_count; ++v) {
+        live[v] = adj.offsets[v + 1] - adj.offsets[v];
+    }
+    std::vector<std::size_t> cache_time(vertex_count);
+    std::vector<bool> emitted(triangle_count);
+    std::vector<std::uint32_t> dead_end;
+    std::vector<std::uint32_t> candidates;
+    std::vector<std::uint32_t> output;
+    output.reserve(indices.size());
+
+    std::size_t time{cache_size + 1};
+    std::uint32_t cursor{};
+
+    auto skip_dead_end = [&]() -> std::uint32_t {
+        while (!dead_end.empty()) {
+            auto v = dead_end.back();
+            dead_end.pop_back();
+            if (live[v] > 0) {
+                return v;
+            }
+        }
+        for (; cursor != vertex_count; ++cursor) {
+            if (live[cursor] > 0) {
+                return cursor;
+            }
+        }
+        return invalid_index;
+    };
+
+    auto next_vertex = [&]() -> std::uint32_t {
+        auto best = invalid_index;
+        std::size_t best_priority{};
+        bool found{};
+        for (auto v : candidates) {
+            if (live[v] == 0) {
+                continue;
+            }
+            // Prefer the oldest vertex that would still be in the cache after
+            // fanning out all of its remaining triangles.
+            std::size_t priority{};
+            if (time - cache_time[v] + (2 * live[v]) <= cache_size) {
+                priority = time - cache_time[v];
+            }
+            if (!found || priority > best_priority) {
+                best = v;
+                best_priority = priority;
+                found = true;
+            }
+        }
+        return found ? best : skip_dead_end();
+    };
+
+    auto fan = skip_dead_end();
+    while (fan != invalid_index) {
+        candidates.clear();
+        for (auto t : adj.of(fan)) {
+            if (emitted[t]) {
+                continue;
+            }
+            emitted[t] = true;
+            for (std::size_t k{}; k != 3; ++k) {
+                auto v = indices[(3 * t) + k];
+                output.push_back(v);
+                dead_end.push_back(v);
+                candidates.push_back(v);
+                --live[v];
+                if (time - cache_time[v] > cache_size) {
+                    cache_time[v] = time++;
+                }
+            }
+        }
+        fan = next_vertex();
+    }
+
+    assert(output.size() == indices.size());
+    std::ranges::copy(output, indices.begin());
+}
+
+void optimize_vertex_fetch(std::vector<Vertex> &vertices,
+                           std::span<std::uint32_t> indices)
+{
+    std::vector<std::uint32_t> remap(vertices.size(), invalid_index);
+    std::vector<Vertex> reordered;
+    reordered.reserve(vertices.size());
+    for (auto &i : indices) {
+        if (remap[i] == invalid_index) {
+            remap[i] = static_cast<std::uint32_t>(reordered.size());
+            reordered.push_back(vertices[i]);
+        }
+        i = remap[i];
+    }
+    vertices = std::move(reordered);
+}
+
+Mesh_optimization_report optimize_mesh(std::vector<Vertex> &vertices,
+                                       std::vector<std::uint32_t> &indices)
+{
+    Mesh_optimization_report report{
+        .vertices_before = vertices.size(),
+        .vertices_after = 0,
+        .acmr_before = compute_acmr(indices, vertices.size()),
+        .acmr_after = 0};
+
+    weld_vertices(vertices, indices);
+    optimize_vertex_cache(indices, vertices.size());
+    optimize_vertex_fetch(vertices, indices);
+
+    report.vertices_after = vertices.size();
+    report.acmr_after = compute_acmr(indices, vertices.size());
+    return report;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <mb/vertex-format.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Size of the post-transform cache the optimizer targets and measures with.
+// Real hardware varies; 16 entries is a conservative common denominator.
+constexpr std::size_t vertex_cache_size{16};
+
+struct Mesh_optimization_report {
+    std::size_t vertices_before;
+    std::size_t vertices_after;
+    float acmr_before;
+    float acmr_after;
+};
+
+// Average cache miss ratio: vertex shader invocations per triangle with a FIFO
+// cache of `cache_size` entries. 3 is the worst case, ~0.5 is a good grid.
+float compute_acmr(std::span<std::uint32_t const> indices,
+                   std::size_t vertex_count,
+                   std::size_t cache_size = vertex_cache_size);
+
+// Merges bitwise identical vertices and rewrites indices accordingly.
+void weld_vertices(std::vector<Vertex> &vertices,
+                   std::span<std::uint32_t> indices);
+
+// Reorders triangles for post-transform cache locality (Tipsify, Sander et
+// al. 2007). Runs in linear time.
+void optimize_vertex_cache(std::span<std::uint32_t> indices,
+                           std::size_t vertex_count,
+                           std::size_t cache_size = vertex_cache_size);
+
+// Renumbers vertices in order of first use so that fetches walk memory
+// forward. Unreferenced vertices are dropped.
+void optimize_vertex_fetch(std::vector<Vertex> &vertices,
+                           std::span<std::uint32_t> indices);
+
+// Runs all of the above on a triangle list.
+Mesh_optimization_report optimize_mesh(std::vector<Vertex> &vertices,
+                                       std::vector<std::uint32_t> &indices);
@@ -1,74 +1,96 @@
 #pragma once
 #include <mb/check-gl-errors.h>
-#include <mb/shader-program.h>
+#include <mb/geometry-arena.h>
 #include <mb/texture.h>
+#include <mb/vertex-format.h>
 
 #include <cassert>
 #include <cstdint>
 #include <glad/gl.h>
+#include <span>
+#include <utility>
 #include <vector>
 
-struct Vertex {
-    glm::vec3 position;
-    glm::vec3 normal;
-    glm::vec2 texcoord;
-};
+// Whether a Mesh keeps its vertices and indices in RAM after uploading them.
+// Only meshes used by physics or picking should need to.
+enum class Cpu_copy { Drop, Retain };
 
-// For rendering, containing vertices of models, vao, vbo, ebo, and textures.
+// For rendering, containing a range of the geometry arena and textures.
 //
-// A mesh doesn't own the texture, while a model does.
+// A mesh doesn't own the texture, while a model does. Drawing goes through
+// Render_queue, which batches meshes sharing a vertex layout.
 class Mesh {
   public:
     Mesh(Mesh const &) = delete;
     Mesh(Mesh &&other) noexcept
-        : vao_(other.vao_), vbo_(other.vbo_), ebo_(other.ebo_),
+        : arena_{std::exchange(other.arena_, nullptr)}, range_{other.range_},
           vertices_(std::move(other.vertices_)),
           indices_(std::move(other.indices_)),
           // textures_{std::move(other.textures_)}
           diffuse_{other.diffuse_}, specular_{other.specular_}
     {
-        other.vao_ = other.vbo_ = other.ebo_ = 0;
         // other.textures_.clear();
     }
     Mesh &operator=(Mesh const &) = delete;
     Mesh &operator=(Mesh &&other) noexcept
     {
-        vao_ = other.vao_;
-        vbo_ = other.vbo_;
-        ebo_ = other.ebo_;
-        other.vao_ = other.vbo_ = other.ebo_ = 0;
-        vertices_ = std::move(other.vertices_);
-        indices_ = std::move(other.indices_);
-        diffuse_ = other.diffuse_;
-        specular_ = other.specular_;
+        if (this != &other) {
+            release();
+            arena_ = std::exchange(other.arena_, nullptr);
+            range_ = other.range_;
+            vertices_ = std::move(other.vertices_);
+            indices_ = std::move(other.indices_);
+            diffuse_ = other.diffuse_;
+            specular_ = other.specular_;
+        }
         return *this;
     }
 
-    Mesh(std::vector<Vertex> vertices, std::vector<std::uint32_t> indices,
-         Texture_view diffuse_map, Texture_view specular_map);
+    Mesh(Geometry_arena &arena, std::vector<Vertex> vertices,
+         std::vector<std::uint32_t> indices, Texture_view diffuse_map,
+         Texture_view specular_map, Cpu_copy cpu_copy = Cpu_copy::Drop);
 
     ~Mesh();
 
-    void render(Shader_program const &shader) const;
+    [[nodiscard]] Geometry_range const &range() const
+    {
+        return range_;
+    }
+
+    [[nodiscard]] GLuint vao() const
+    {
+        assert(arena_ != nullptr && "Using possibly `std::move`d mesh");
+        return arena_->vao(range_.layout);
+    }
+
+    [[nodiscard]] Texture_view diffuse() const
+    {
+        return diffuse_;
+    }
 
-    [[deprecated("this->vertices_ will be removed in the future, so this "
-                 "function will too be removed.")]] [[nodiscard]]
-    auto const &vertices() const;
+    [[nodiscard]] Texture_view specular() const
+    {
+        return specular_;
+    }
+
+    // Bytes this mesh occupies in the arena's vbo and ebo.
+    [[nodiscard]] std::size_t gpu_size_in_bytes() const
+    {
+        return (range_.vertex_count * range_.layout.stride()) +
+               (range_.index_count * range_.layout.index_size());
+    }
 
-    [[deprecated("this->indices_ will be removed in the future, so this "
-                 "function will too be removed.")]] [[nodiscard]]
-    auto const &indices() const;
+    // Only available for meshes constructed with Cpu_copy::Retain.
+    [[nodiscard]] std::span<Vertex const> cpu_vertices() const;
+    [[nodiscard]] std::span<std::uint32_t const> cpu_indices() const;
 
   private:
-    [[deprecated("Don't depend too much on this, as this may be sign of bad "
-                 "smell of code..")]]
-    void bind_diffuse_and_specular(int diff, int spec) const;
+    void release();
 
-    // Initial invalid value for error checking: if it's 0 , then it indicates
-    // an error or the Mesh object doesn't own the model.
-    GLuint vao_{};
-    GLuint vbo_{};
-    GLuint ebo_{};
+    // nullptr if the mesh has been moved from.
+    Geometry_arena *arena_;
+    Geometry_range range_;
+    // Empty unless constructed with Cpu_copy::Retain.
     std::vector<Vertex> vertices_;
     std::vector<std::uint32_t> indices_;
     // std::vector<Texture> textures_;
@@ -1,22 +1,29 @@
 #pragma once
+#include <mb/animation.h>
+#include <mb/mesh-optimizer.h>
 #include <mb/mesh.h>
+#include <mb/render-queue.h>
+#include <mb/resource-cache.h>
 
+#include <algorithm>
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
-#include <unordered_map>
+#include <glm/gtc/type_ptr.hpp>
+#include <memory>
+#include <span>
 #include <utility>
 
+// Textures are shared through the Resource_cache; a Model only holds handles
+// to keep the ones its meshes reference alive. Load file models through
+// `Resource_cache::load_model` rather than constructing them directly.
 class Model {
   public:
-    Model(std::filesystem::path const &path)
+    Model(Resource_cache &cache, std::filesystem::path const &path)
+        : cache_{&cache}
     {
         spdlog::info("Loading model {}", path.string());
 
-        std::array<unsigned char, 4> default_grey{100, 100, 100, 255};
-        textures_.insert(
-            {"path:default", Texture(1, 1, GL_RGBA, default_grey.data())});
-
         Assimp::Importer importer;
         // A few other useful options are:
 
@@ -31,7 +38,8 @@ class Model {
         //   meshes into one larger mesh, reducing drawing calls for
         //   optimization.
         aiScene const *scene{importer.ReadFile(
-            path.string(), aiProcess_Triangulate | aiProcess_FlipUVs)};
+            path.string(), aiProcess_Triangulate | aiProcess_FlipUVs |
+                               aiProcess_LimitBoneWeights)};
         if (scene == nullptr ||
             static_cast<bool>(scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE) ||
             scene->mRootNode == nullptr) {
@@ -40,29 +48,178 @@ class Model {
             throw std::runtime_error("check last error");
         }
 
+        // The skeleton is the whole node hierarchy, so that bones can be
+        // resolved by name while extracting meshes.
+        load_skeleton(scene->mRootNode, -1);
+        skeleton_.global_inverse =
+            glm::inverse(to_glm(scene->mRootNode->mTransformation));
+
         auto model_parent = path.parent_path();
         process_assimp_node(scene->mRootNode, scene, model_parent);
-        spdlog::info("Loaded model {}", path.string());
+        load_animations(scene);
+
+        bind_palette_.resize(skeleton_.size());
+        std::vector<glm::mat4> globals(skeleton_.size());
+        build_palette(skeleton_, skeleton_.rest_pose, globals, bind_palette_);
+        spdlog::info("Loaded model {}: {} joints, {} clips", path.string(),
+                     skeleton_.size(), clips_.size());
     }
 
-    Model(std::vector<Vertex> vertices, std::vector<std::uint32_t> indices,
-          Texture diffuse_map, Texture specular_map)
+    Model(Resource_cache &cache, std::vector<Vertex> vertices,
+          std::vector<std::uint32_t> indices,
+          std::shared_ptr<Texture const> diffuse_map,
+          std::shared_ptr<Texture const> specular_map,
+          Cpu_copy cpu_copy = Cpu_copy::Drop)
+        : cache_{&cache}
     {
-        textures_.insert({"path:diffuse", std::move(diffuse_map)});
-        textures_.insert({"path:specular", std::move(specular_map)});
-        meshes_.emplace_back(std::move(vertices), std::move(indices),
-                             Texture_view(textures_.at("path:diffuse")),
-                             Texture_view(textures_.at("path:specular")));
+        optimize(vertices, indices);
+        meshes_.emplace_back(cache.geometry(), std::move(vertices),
+                             std::move(indices), Texture_view(*diffuse_map),
+                             Texture_view(*specular_map), cpu_copy);
+        textures_.push_back(std::move(diffuse_map));
+        textures_.push_back(std::move(specular_map));
     }
 
-    void render(Shader_program const &shader) const
+    // Skinned meshes are drawn with `palette`, or in their bind pose if it is
+    // empty.
+    void submit(Render_queue &queue, Shader_program const &shader,
+                glm::mat4 const &model, glm::mat3 const &normal,
+                std::span<glm::mat4 const> palette = {}) const
     {
+        if (palette.empty()) {
+            palette = bind_palette_;
+        }
         for (auto const &mesh : meshes_) {
-            mesh.render(shader);
+            queue.submit(shader, mesh, model, normal, palette);
         }
     }
 
+    [[nodiscard]] Skeleton const &skeleton() const
+    {
+        return skeleton_;
+    }
+
+    [[nodiscard]] std::span<Animation_clip const> clips() const
+    {
+        return clips_;
+    }
+
+    [[nodiscard]] bool is_animated() const
+    {
+        return !clips_.empty();
+    }
+
   private:
+    static glm::mat4 to_glm(aiMatrix4x4 const &m)
+    {
+        // Assimp is row-major, glm column-major.
+        return glm::transpose(glm::make_mat4(&m.a1));
+    }
+
+    void load_skeleton(aiNode const *node, int parent)
+    {
+        aiVector3D scale;
+        aiQuaternion rotation;
+        aiVector3D translation;
+        node->mTransformation.Decompose(scale, rotation, translation);
+
+        auto index = static_cast<int>(skeleton_.size());
+        skeleton_.names.emplace_back(node->mName.C_Str());
+        skeleton_.parents.push_back(parent);
+        skeleton_.rest_pose.push_back(Joint_pose{
+            .translation = {translation.x, translation.y, translation.z, 0},
+            .rotation = {rotation.w, rotation.x, rotation.y, rotation.z},
+            .scale = {scale.x, scale.y, scale.z, 0}});
+        skeleton_.inverse_bind.emplace_back(1);
+        for (unsigned int i{}; i != node->mNumChildren; ++i) {
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            load_skeleton(node->mChildren[i], index);
+        }
+    }
+
+    void load_animations(aiScene const *scene)
+    {
+        for (unsigned int i{}; i != scene->mNumAnimations; ++i) {
+            // NOLINTBEGIN(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            aiAnimation const *anim = scene->mAnimations[i];
+            // Some exporters leave the tick rate unset.
+            double ticks_per_second =
+                anim->mTicksPerSecond != 0 ? anim->mTicksPerSecond : 25;
+            auto seconds = [&](double ticks) {
+                return static_cast<float>(ticks / ticks_per_second);
+            };
+
+            Animation_clip clip{
+                .name = anim->mName.C_Str(),
+                .duration = seconds(anim->mDuration),
+                .tracks = std::vector<Joint_track>(skeleton_.size())};
+            for (unsigned int c{}; c != anim->mNumChannels; ++c) {
+                aiNodeAnim const *channel = anim->mChannels[c];
+                auto joint = skeleton_.find(channel->mNodeName.C_Str());
+                if (joint < 0) {
+                    spdlog::warn("Animation {} drives unknown node {}",
+                                 clip.name, channel->mNodeName.C_Str());
+                    continue;
+                }
+                auto &track = clip.tracks[joint];
+                for (unsigned int k{}; k != channel->mNumPositionKeys; ++k) {
+                    auto const &key = channel->mPositionKeys[k];
+                    track.translation.times.push_back(seconds(key.mTime));
+                    track.translation.values.emplace_back(
+                        key.mValue.x, key.mValue.y, key.mValue.z);
+                }
+                for (unsigned int k{}; k != channel->mNumRotationKeys; ++k) {
+                    auto const &key = channel->mRotationKeys[k];
+                    track.rotation.times.push_back(seconds(key.mTime));
+                    track.rotation.values.emplace_back(
+                        key.mValue.w, key.mValue.x, key.mValue.y, key.mValue.z);
+                }
+                for (unsigned int k{}; k != channel->mNumScalingKeys; ++k) {
+                    auto const &key = channel->mScalingKeys[k];
+                    track.scale.times.push_back(seconds(key.mTime));
+                    track.scale.values.emplace_back(key.mValue.x, key.mValue.y,
+                                                    key.mValue.z);
+                }
+            }
+            // NOLINTEND(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            clips_.push_back(std::move(clip));
+        }
+    }
+
+    // Fills `vertices`' joints and weights from the bones of `mesh`.
+    void load_skin(aiMesh const *mesh, std::vector<Vertex> &vertices)
+    {
+        for (unsigned int b{}; b != mesh->mNumBones; ++b) {
+            // NOLINTBEGIN(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            aiBone const *bone = mesh->mBones[b];
+            auto joint = skeleton_.find(bone->mName.C_Str());
+            if (joint < 0) {
+                spdlog::warn("Bone {} has no node, ignoring it",
+                             bone->mName.C_Str());
+                continue;
+            }
+            skeleton_.inverse_bind[joint] = to_glm(bone->mOffsetMatrix);
+            for (unsigned int w{}; w != bone->mNumWeights; ++w) {
+                auto const &weight = bone->mWeights[w];
+                auto &v = vertices[weight.mVertexId];
+                // aiProcess_LimitBoneWeights leaves at most four per vertex,
+                // so the lightest slot is always an empty one.
+                std::span<float, 4> weights{&v.weights.x, 4};
+                auto slot = static_cast<std::size_t>(
+                    std::ranges::min_element(weights) - weights.begin());
+                v.joints[slot] = static_cast<std::uint16_t>(joint);
+                weights[slot] = weight.mWeight;
+            }
+            // NOLINTEND(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        }
+        // Vertices no bone reaches follow the root.
+        for (auto &v : vertices) {
+            if (v.weights == glm::vec4{}) {
+                v.weights.x = 1;
+            }
+        }
+    }
+
     void process_assimp_node(aiNode const *node, aiScene const *scene,
                              std::filesystem::path const &model_parent)
     {
@@ -113,6 +270,10 @@ class Model {
             // NOLINTEND(cppcoreguidelines-pro-bounds-pointer-arithmetic)
         }
 
+        if (mesh->HasBones()) {
+            load_skin(mesh, vertices);
+        }
+
         if (mesh->mMaterialIndex >= scene->mNumMaterials) {
             spdlog::warn("Model doesn't have any material");
             throw std::runtime_error("check last error");
@@ -124,13 +285,15 @@ class Model {
         Texture_view specular{load_material_texture(
             scene, material, aiTextureType_SPECULAR, model_parent)};
 
-        return Mesh{std::move(vertices), std::move(indices), diffuse, specular};
+        optimize(vertices, indices);
+        return Mesh{cache_->geometry(), std::move(vertices), std::move(indices),
+                    diffuse, specular};
     }
 
     Texture_view
     load_material_texture(aiScene const *scene, aiMaterial const *mat,
                           aiTextureType type,
-                          std::filesystem::path const &model_parent) const
+                          std::filesystem::path const &model_parent)
     {
         unsigned int num_textures{mat->GetTextureCount(type)};
         for (unsigned int i{}; i != num_textures; i++) {
@@ -147,44 +310,56 @@ class Model {
 
                 // BGRA format
                 if (texture->achFormatHint[0] == '\0') {
-                    textures_.insert({rel_path.C_Str(),
-                                      Texture(width, height, GL_BGRA, data)});
-                    return Texture_view(textures_.at(rel_path.C_Str()));
+                    auto size = static_cast<std::size_t>(width) * height *
+                                sizeof(aiTexel);
+                    return hold(cache_->load_texture(width, height, GL_BGRA,
+                                                     {data, size}));
                 }
 
                 // Compressed image format
                 assert(height == 0 && "height should be zero because now ought "
                                       "to be in compressed image mode");
-                int channels;
-                unsigned char *rgba_data = stbi_load_from_memory(
-                    data, width, &width, &height, &channels, 4);
-                if (rgba_data == nullptr) {
-                    spdlog::error(
-                        "Failed to read image from memory: MEMORY LAYOUT:");
-                    spdlog::error("{}", reinterpret_cast<char const *>(data));
-                    throw std::runtime_error("check last error");
-                }
-                textures_.insert({rel_path.C_Str(),
-                                  Texture(width, height, GL_RGBA, rgba_data)});
-                stbi_image_free(rgba_data);
-                return Texture_view(textures_.at(rel_path.C_Str()));
+                return hold(cache_->load_texture(
+                    {data, static_cast<std::size_t>(width)}));
             }
 
             auto path = model_parent / rel_path.C_Str();
             spdlog::info("path={}", path.string());
-            if (!textures_.contains(path)) {
-                textures_.insert({path, Texture(path)});
-            }
-            return Texture_view{textures_.at(path)};
+            return hold(cache_->load_texture(path));
         }
         spdlog::warn(
             "can't find desired texture type {}, using default grey texture",
             static_cast<int>(type));
-        return Texture_view(textures_.at("path:default"));
+        return hold(cache_->default_texture());
+    }
+
+    // Assimp hands out vertices unwelded and triangles in authoring order;
+    // clean both up before they reach the GPU.
+    static void optimize(std::vector<Vertex> &vertices,
+                         std::vector<std::uint32_t> &indices)
+    {
+        auto report = optimize_mesh(vertices, indices);
+        spdlog::info("Optimized mesh: {} -> {} vertices, ACMR {:.3f} -> {:.3f}",
+                     report.vertices_before, report.vertices_after,
+                     report.acmr_before, report.acmr_after);
+    }
+
+    Texture_view hold(std::shared_ptr<Texture const> texture)
+    {
+        Texture_view view{*texture};
+        if (!std::ranges::contains(textures_, texture)) {
+            textures_.push_back(std::move(texture));
+        }
+        return view;
     }
 
     std::vector<Mesh> meshes_;
-    // Cached
-    mutable std::unordered_map<std::filesystem::path, Texture> textures_;
+    // Keeps textures referenced by meshes_ alive.
+    std::vector<std::shared_ptr<Texture const>> textures_;
+    Skeleton skeleton_;
+    std::vector<Animation_clip> clips_;
+    // Rest pose palette, for skinned meshes of entities without an Animator.
+    std::vector<glm::mat4> bind_palette_;
+    Resource_cache *cache_{};
     float scale_{1};
 };
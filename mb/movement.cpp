@@ -0,0 +1,114 @@
+#include <mb/movement.h>
+
+#include <mb/height-field.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+constexpr float still_length{1e-5F};
+
+using Lane = std::array<float, movement_lanes>;
+
+// One batch of entities transposed to one array per coordinate, so each
+// step of the kernel works on all of them at once.
+struct Batch {
+    alignas(32) Lane x;
+    alignas(32) Lane y;
+    alignas(32) Lane z;
+    alignas(32) Lane dx;
+    alignas(32) Lane dy;
+    alignas(32) Lane dz;
+    alignas(32) Lane speed;
+};
+
+void integrate(Batch &b, float dt)
+{
+#if defined(__AVX__)
+    auto dx = _mm256_load_ps(b.dx.data());
+    auto dy = _mm256_load_ps(b.dy.data());
+    auto dz = _mm256_load_ps(b.dz.data());
+    auto length = _mm256_sqrt_ps(_mm256_add_ps(
+        _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)),
+        _mm256_mul_ps(dz, dz)));
+    auto moving =
+        _mm256_cmp_ps(length, _mm256_set1_ps(still_length), _CMP_GE_OQ);
+    auto step = _mm256_and_ps(
+        moving,
+        _mm256_div_ps(
+            _mm256_mul_ps(_mm256_load_ps(b.speed.data()), _mm256_set1_ps(dt)),
+            length));
+    _mm256_store_ps(b.x.data(), _mm256_add_ps(_mm256_load_ps(b.x.data()),
+                                              _mm256_mul_ps(dx, step)));
+    _mm256_store_ps(b.y.data(), _mm256_add_ps(_mm256_load_ps(b.y.data()),
+                                              _mm256_mul_ps(dy, step)));
+    _mm256_store_ps(b.z.data(), _mm256_add_ps(_mm256_load_ps(b.z.data()),
+                                              _mm256_mul_ps(dz, step)));
+#else
+    // Same arithmetic, lane by lane; compilers turn it into SSE.
+    for (std::size_t i{}; i != movement_lanes; ++i) {
+        auto length = std::sqrt((b.dx[i] * b.dx[i]) + (b.dy[i] * b.dy[i]) +
+                                (b.dz[i] * b.dz[i]));
+        auto step = length >= still_length ? b.speed[i] * dt / length : 0.0F;
+        b.x[i] += b.dx[i] * step;
+        b.y[i] += b.dy[i] * step;
+        b.z[i] += b.dz[i] * step;
+    }
+#endif
+}
+
+} // namespace
+
+void integrate_movement(std::span<Position> positions,
+                        std::span<Velocity const> velocities, float dt)
+{
+    for (std::size_t first{}; first < positions.size();
+         first += movement_lanes) {
+        auto n = std::min(movement_lanes, positions.size() - first);
+        // Lanes past the end stay still.
+        Batch b{};
+        for (std::size_t i{}; i != n; ++i) {
+            auto const &p = positions[first + i].value;
+            auto const &v = velocities[first + i];
+            b.x[i] = p.x;
+            b.y[i] = p.y;
+            b.z[i] = p.z;
+            b.dx[i] = v.dir.x;
+            b.dy[i] = v.dir.y;
+            b.dz[i] = v.dir.z;
+            b.speed[i] = v.speed;
+        }
+        integrate(b, dt);
+        for (std::size_t i{}; i != n; ++i) {
+            positions[first + i].value = {b.x[i], b.y[i], b.z[i]};
+        }
+    }
+}
+
+void snap_to_terrain(std::span<Position *const> positions,
+                     Height_field const &terrain)
+{
+    for (std::size_t first{}; first < positions.size();
+         first += movement_lanes) {
+        auto n = std::min(movement_lanes, positions.size() - first);
+        // Whole batches, so the lookup loop has a fixed trip count; the
+        // lanes past the end sample the corner and are dropped.
+        Lane x{};
+        Lane z{};
+        Lane y{};
+        for (std::size_t i{}; i != n; ++i) {
+            x[i] = positions[first + i]->value.x;
+            z[i] = positions[first + i]->value.z;
+        }
+        terrain.sample(x, z, y);
+        for (std::size_t i{}; i != n; ++i) {
+            positions[first + i]->value.y = y[i];
+        }
+    }
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <mb/common-components.h>
+
+#include <cstddef>
+#include <span>
+
+class Height_field;
+
+// Entities the movement kernels take per step: one AVX register of floats.
+inline constexpr std::size_t movement_lanes{8};
+
+// Moves every position along its velocity for `dt` seconds; a direction
+// shorter than 1e-5 means standing still. `positions` and `velocities` are
+// parallel arrays. Safe to run on disjoint ranges from several threads.
+void integrate_movement(std::span<Position> positions,
+                        std::span<Velocity const> velocities, float dt);
+
+// Puts every position on the terrain; `positions` may point anywhere.
+void snap_to_terrain(std::span<Position *const> positions,
+                     Height_field const &terrain);
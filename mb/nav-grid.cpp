@@ -0,0 +1,296 @@
+#include <mb/nav-grid.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <numbers>
+
+namespace {
+
+// How much a slope of 1 multiplies the cost of a step.
+constexpr float slope_penalty{4.0F};
+
+constexpr std::array<Grid_cell, 8> neighbour_offsets{{
+    {.x = 1, .z = 0},
+    {.x = -1, .z = 0},
+    {.x = 0, .z = 1},
+    {.x = 0, .z = -1},
+    {.x = 1, .z = 1},
+    {.x = 1, .z = -1},
+    {.x = -1, .z = 1},
+    {.x = -1, .z = -1},
+}};
+
+constexpr auto no_parent = std::numeric_limits<std::uint32_t>::max();
+
+// Per-thread search state, reused across searches. Entries are valid only if
+// their stamp equals the current generation, so nothing is cleared between
+// searches.
+struct Search_scratch {
+    struct Open_entry {
+        float f;
+        std::uint32_t cell;
+
+        bool operator>(Open_entry const &other) const
+        {
+            return f > other.f;
+        }
+    };
+
+    std::vector<float> g;
+    std::vector<std::uint32_t> parent;
+    std::vector<std::uint32_t> seen;
+    std::vector<std::uint32_t> closed;
+    std::vector<Open_entry> open;
+    std::uint32_t generation{};
+
+    void begin(std::size_t cells)
+    {
+        if (g.size() != cells) {
+            g.assign(cells, 0);
+            parent.assign(cells, no_parent);
+            seen.assign(cells, 0);
+            closed.assign(cells, 0);
+            generation = 0;
+        }
+        if (++generation == 0) { // Wrapped; stale stamps could match again.
+            std::ranges::fill(seen, 0);
+            std::ranges::fill(closed, 0);
+            generation = 1;
+        }
+        open.clear();
+    }
+};
+
+Search_scratch &scratch()
+{
+    thread_local Search_scratch s;
+    return s;
+}
+
+int sign(int v)
+{
+    return (v > 0) - (v < 0);
+}
+
+// Best-first search from `from` that never leaves `bounds`. `settle(cell, g)`
+// is called for each cell as its cost becomes final and returns true to stop.
+// On return the scratch's parent links describe the search tree.
+template <typename Estimate, typename Settle>
+void search(Nav_grid const &grid, Grid_cell from, Cell_rect bounds,
+            Estimate const &estimate, Settle const &settle)
+{
+    auto &s = scratch();
+    s.begin(grid.size());
+    auto const gen = s.generation;
+
+    auto start = grid.index_of(from);
+    s.g[start] = 0;
+    s.parent[start] = no_parent;
+    s.seen[start] = gen;
+    s.open.push_back({.f = estimate(from), .cell = start});
+
+    while (!s.open.empty()) {
+        std::ranges::pop_heap(s.open, std::greater{});
+        auto current = s.open.back().cell;
+        s.open.pop_back();
+        if (s.closed[current] == gen) {
+            continue; // Stale entry; a cheaper one was expanded already.
+        }
+        s.closed[current] = gen;
+        if (settle(current, s.g[current])) {
+            return;
+        }
+
+        auto cell = grid.cell_at(current);
+        for (auto offset : neighbour_offsets) {
+            Grid_cell next{.x = cell.x + offset.x, .z = cell.z + offset.z};
+            if (!bounds.contains(next)) {
+                continue;
+            }
+            auto step = grid.step_cost(cell, next);
+            if (!step) {
+                continue;
+            }
+            // No corner cutting past unwalkable orthogonal neighbours.
+            if (offset.x != 0 && offset.z != 0 &&
+                (!grid.step_cost(cell, {.x = next.x, .z = cell.z}) ||
+                 !grid.step_cost(cell, {.x = cell.x, .z = next.z}))) {
+                continue;
+            }
+            auto n = grid.index_of(next);
+            if (s.closed[n] == gen) {
+                continue;
+            }
+            float g = s.g[current] + *step;
+            if (s.seen[n] == gen && g >= s.g[n]) {
+                continue;
+            }
+            s.seen[n] = gen;
+            s.g[n] = g;
+            s.parent[n] = current;
+            s.open.push_back({.f = g + estimate(next), .cell = n});
+            std::ranges::push_heap(s.open, std::greater{});
+        }
+    }
+}
+
+} // namespace
+
+Nav_grid::Nav_grid(std::vector<std::vector<float>> const &height_map)
+    : width_{height_map.empty() ? 0 : static_cast<int>(height_map[0].size())},
+      depth_{static_cast<int>(height_map.size())}
+{
+    heights_.reserve(static_cast<std::size_t>(width_) * depth_);
+    for (auto const &row : height_map) {
+        heights_.insert(heights_.end(), row.begin(), row.end());
+    }
+}
+
+Grid_cell Nav_grid::cell_of(glm::vec3 pos) const
+{
+    return {.x = std::clamp(static_cast<int>(std::round(pos.x)), 0, width_ - 1),
+            .z =
+                std::clamp(static_cast<int>(std::round(pos.z)), 0, depth_ - 1)};
+}
+
+glm::vec3 Nav_grid::position_of(Grid_cell c) const
+{
+    return {static_cast<float>(c.x), height(c), static_cast<float>(c.z)};
+}
+
+std::optional<float> Nav_grid::step_cost(Grid_cell from, Grid_cell to) const
+{
+    bool diagonal = from.x != to.x && from.z != to.z;
+    float run = diagonal ? std::numbers::sqrt2_v<float> : 1.0F;
+    float slope = std::abs(height(to) - height(from)) / run;
+    if (slope > max_walkable_slope) {
+        return std::nullopt;
+    }
+    return run * (1 + (slope_penalty * slope));
+}
+
+float octile_distance(Grid_cell a, Grid_cell b)
+{
+    auto dx = static_cast<float>(std::abs(a.x - b.x));
+    auto dz = static_cast<float>(std::abs(a.z - b.z));
+    return std::max(dx, dz) +
+           ((std::numbers::sqrt2_v<float> - 1) * std::min(dx, dz));
+}
+
+std::vector<Grid_cell> collapse_collinear(std::vector<Grid_cell> cells)
+{
+    if (cells.size() <= 2) {
+        return cells;
+    }
+    std::vector<Grid_cell> out{cells.front()};
+    for (std::size_t i{1}; i + 1 != cells.size(); ++i) {
+        // Every leg is 8-directional, so comparing signs compares directions
+        // even for legs that were collapsed already.
+        auto in = Grid_cell{.x = sign(cells[i].x - cells[i - 1].x),
+                            .z = sign(cells[i].z - cells[i - 1].z)};
+        auto next = Grid_cell{.x = sign(cells[i + 1].x - cells[i].x),
+                              .z = sign(cells[i + 1].z - cells[i].z)};
+        if (in != next) {
+            out.push_back(cells[i]);
+        }
+    }
+    out.push_back(cells.back());
+    return out;
+}
+
+std::optional<std::vector<Grid_cell>> find_path(Nav_grid const &grid,
+                                                Grid_cell from, Grid_cell to,
+                                                std::optional<Cell_rect> bounds)
+{
+    auto area = bounds.value_or(grid.bounds());
+    if (!grid.contains(from) || !grid.contains(to) || !area.contains(from) ||
+        !area.contains(to)) {
+        return std::nullopt;
+    }
+
+    auto goal = grid.index_of(to);
+    bool found{};
+    search(
+        grid, from, area, [&](Grid_cell c) { return octile_distance(c, to); },
+        [&](std::uint32_t cell, float) { return found = cell == goal; });
+    if (!found) {
+        return std::nullopt;
+    }
+
+    auto const &s = scratch();
+    std::vector<Grid_cell> cells;
+    for (auto c = goal; c != no_parent; c = s.parent[c]) {
+        cells.push_back(grid.cell_at(c));
+    }
+    std::ranges::reverse(cells);
+    return collapse_collinear(std::move(cells));
+}
+
+std::vector<float> path_costs(Nav_grid const &grid, Grid_cell from,
+                              std::span<Grid_cell const> targets,
+                              Cell_rect bounds,
+                              std::vector<std::vector<Grid_cell>> *routes)
+{
+    std::vector<float> costs(targets.size(),
+                             std::numeric_limits<float>::infinity());
+    if (routes != nullptr) {
+        routes->assign(targets.size(), {});
+    }
+    if (!bounds.contains(from)) {
+        return costs;
+    }
+    std::size_t remaining{targets.size()};
+    search(
+        grid, from, bounds, [](Grid_cell) { return 0.0F; },
+        [&](std::uint32_t cell, float g) {
+            for (std::size_t i{}; i != targets.size(); ++i) {
+                if (grid.index_of(targets[i]) == cell) {
+                    costs[i] = g;
+                    --remaining;
+                }
+            }
+            return remaining == 0;
+        });
+    if (routes == nullptr) {
+        return costs;
+    }
+
+    auto const &s = scratch();
+    for (std::size_t i{}; i != targets.size(); ++i) {
+        if (costs[i] == std::numeric_limits<float>::infinity()) {
+            continue;
+        }
+        auto &route = (*routes)[i];
+        for (auto c = grid.index_of(targets[i]); c != no_parent;
+             c = s.parent[c]) {
+            route.push_back(grid.cell_at(c));
+        }
+        std::ranges::reverse(route);
+        route = collapse_collinear(std::move(route));
+    }
+    return costs;
+}
+
+std::vector<float> cost_field(Nav_grid const &grid, Grid_cell goal,
+                              Cell_rect bounds)
+{
+    auto width = bounds.x1 - bounds.x0;
+    std::vector<float> costs(static_cast<std::size_t>(width) *
+                                 (bounds.z1 - bounds.z0),
+                             std::numeric_limits<float>::infinity());
+    if (!bounds.contains(goal)) {
+        return costs;
+    }
+    // Steps cost the same both ways, so searching outwards from the goal
+    // gives every cell's cost to it.
+    search(
+        grid, goal, bounds, [](Grid_cell) { return 0.0F; },
+        [&](std::uint32_t cell, float g) {
+            auto c = grid.cell_at(cell);
+            costs[((c.z - bounds.z0) * width) + (c.x - bounds.x0)] = g;
+            return false;
+        });
+    return costs;
+}
@@ -0,0 +1,123 @@
+#pragma once
+#include <compare>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <optional>
+#include <span>
+#include <vector>
+
+// A sample point of the height map; cell (x, z) sits at world (x, h, z).
+struct Grid_cell {
+    int x;
+    int z;
+
+    auto operator<=>(Grid_cell const &) const = default;
+};
+
+// Half-open rectangle of cells, [x0, x1) x [z0, z1).
+struct Cell_rect {
+    int x0;
+    int z0;
+    int x1;
+    int z1;
+
+    [[nodiscard]] bool contains(Grid_cell c) const
+    {
+        return c.x >= x0 && c.x < x1 && c.z >= z0 && c.z < z1;
+    }
+};
+
+// Steeper steps (rise over run) can't be walked at all.
+constexpr float max_walkable_slope{1.0F};
+
+/// @brief Walkability and movement costs of the terrain, for pathfinding.
+///
+/// Heights are stored flat, row by row, so that searches touch contiguous
+/// memory. Searches share a grid read-only, so terrain edits are made to a
+/// copy (see Path_service::edit_terrain).
+class Nav_grid {
+  public:
+    explicit Nav_grid(std::vector<std::vector<float>> const &height_map);
+
+    [[nodiscard]] int width() const
+    {
+        return width_;
+    }
+    [[nodiscard]] int depth() const
+    {
+        return depth_;
+    }
+    [[nodiscard]] std::size_t size() const
+    {
+        return heights_.size();
+    }
+
+    [[nodiscard]] bool contains(Grid_cell c) const
+    {
+        return c.x >= 0 && c.x < width_ && c.z >= 0 && c.z < depth_;
+    }
+    [[nodiscard]] Cell_rect bounds() const
+    {
+        return {.x0 = 0, .z0 = 0, .x1 = width_, .z1 = depth_};
+    }
+    [[nodiscard]] std::uint32_t index_of(Grid_cell c) const
+    {
+        return static_cast<std::uint32_t>((c.z * width_) + c.x);
+    }
+    [[nodiscard]] Grid_cell cell_at(std::uint32_t index) const
+    {
+        return {.x = static_cast<int>(index % width_),
+                .z = static_cast<int>(index / width_)};
+    }
+    [[nodiscard]] float height(Grid_cell c) const
+    {
+        return heights_[index_of(c)];
+    }
+
+    // Nearest cell to `pos`, clamped into the grid.
+    [[nodiscard]] Grid_cell cell_of(glm::vec3 pos) const;
+    [[nodiscard]] glm::vec3 position_of(Grid_cell c) const;
+
+    // Cost of moving from `from` to its 8-neighbour `to`: distance, inflated
+    // with the slope. std::nullopt if the step is too steep.
+    [[nodiscard]] std::optional<float> step_cost(Grid_cell from,
+                                                 Grid_cell to) const;
+
+    void set_height(Grid_cell c, float height)
+    {
+        heights_[index_of(c)] = height;
+    }
+
+  private:
+    int width_;
+    int depth_;
+    std::vector<float> heights_;
+};
+
+// Lower bound of the cost between two cells: every step costs at least its
+// length.
+float octile_distance(Grid_cell a, Grid_cell b);
+
+// 8-connected A* from `from` to `to`, never leaving `bounds`. Returns the
+// visited cells, both ends included, with collinear runs collapsed to their
+// end points; std::nullopt if `to` can't be reached.
+std::optional<std::vector<Grid_cell>>
+find_path(Nav_grid const &grid, Grid_cell from, Grid_cell to,
+          std::optional<Cell_rect> bounds = std::nullopt);
+
+// Cheapest cost from `from` to each of `targets` without leaving `bounds`,
+// infinity for unreachable ones. One Dijkstra search for all targets. With
+// `routes`, also the cheapest route to each, collapsed like find_path's and
+// empty for unreachable ones.
+std::vector<float>
+path_costs(Nav_grid const &grid, Grid_cell from,
+           std::span<Grid_cell const> targets, Cell_rect bounds,
+           std::vector<std::vector<Grid_cell>> *routes = nullptr);
+
+// Cheapest cost from every cell of `bounds` to `goal` without leaving it,
+// row by row over `bounds`; infinity for cells that can't reach `goal`.
+std::vector<float> cost_field(Nav_grid const &grid, Grid_cell goal,
+                              Cell_rect bounds);
+
+// Drops waypoints in the middle of straight 8-directional runs.
+std::vector<Grid_cell> collapse_collinear(std::vector<Grid_cell> cells);
@@ -0,0 +1,409 @@
+#include <mb/nav-hierarchy.h>
+
+#include <algorithm>
+#include <limits>
+#include <set>
+#include <spdlog/spdlog.h>
+#include <utility>
+
+namespace {
+
+// Entrances longer than this get a transition at each end rather than one in
+// the middle, so that routes along a wide open border aren't funnelled
+// through its centre.
+constexpr int long_entrance{6};
+
+// Inflates the abstract search's heuristic. Portal placement already makes
+// routes slightly longer than the grid's best; leaning on the heuristic
+// keeps long queries from settling most of the map's portals first, for a
+// few percent of length at worst.
+constexpr float heuristic_weight{1.5F};
+
+constexpr auto no_node = std::numeric_limits<std::uint32_t>::max();
+
+// Same stamping scheme as the grid search, over abstract nodes.
+struct Abstract_scratch {
+    struct Open_entry {
+        float f;
+        std::uint32_t node;
+
+        bool operator>(Open_entry const &other) const
+        {
+            return f > other.f;
+        }
+    };
+
+    std::vector<float> g;
+    std::vector<std::uint32_t> parent;
+    std::vector<std::uint32_t> seen;
+    std::vector<std::uint32_t> closed;
+    std::vector<Open_entry> open;
+    std::uint32_t generation{};
+
+    void begin(std::size_t nodes)
+    {
+        if (g.size() < nodes) {
+            g.resize(nodes);
+            parent.resize(nodes, no_node);
+            seen.resize(nodes);
+            closed.resize(nodes);
+        }
+        if (++generation == 0) {
+            std::ranges::fill(seen, 0);
+            std::ranges::fill(closed, 0);
+            generation = 1;
+        }
+        open.clear();
+    }
+};
+
+} // namespace
+
+Nav_hierarchy::Nav_hierarchy(Nav_grid const &grid, int cluster_size)
+    : cluster_size_{cluster_size},
+      clusters_x_{(grid.width() + cluster_size - 1) / cluster_size},
+      clusters_z_{(grid.depth() + cluster_size - 1) / cluster_size}
+{
+    for (int z{}; z != clusters_z_; ++z) {
+        for (int x{}; x != clusters_x_; ++x) {
+            clusters_.push_back(Cluster{
+                .bounds = {.x0 = x * cluster_size,
+                           .z0 = z * cluster_size,
+                           .x1 = std::min((x + 1) * cluster_size, grid.width()),
+                           .z1 = std::min((z + 1) * cluster_size,
+                                          grid.depth())},
+                .nodes = {}});
+        }
+    }
+    for (std::uint32_t c{}; c != clusters_.size(); ++c) {
+        if (static_cast<int>(c % clusters_x_) + 1 < clusters_x_) {
+            link_border(grid, c, c + 1);
+        }
+        if (static_cast<int>(c / clusters_x_) + 1 < clusters_z_) {
+            link_border(grid, c, c + clusters_x_);
+        }
+    }
+    for (std::uint32_t c{}; c != clusters_.size(); ++c) {
+        connect_cluster(grid, c);
+    }
+    spdlog::info("Nav hierarchy: {} clusters of {}x{} cells, {} portals",
+                 clusters_.size(), cluster_size, cluster_size,
+                 portal_count());
+}
+
+std::uint32_t Nav_hierarchy::cluster_of(Grid_cell c) const
+{
+    return static_cast<std::uint32_t>(((c.z / cluster_size_) * clusters_x_) +
+                                      (c.x / cluster_size_));
+}
+
+std::vector<std::uint32_t>
+Nav_hierarchy::neighbours_of(std::uint32_t cluster) const
+{
+    std::vector<std::uint32_t> out;
+    auto x = static_cast<int>(cluster % clusters_x_);
+    auto z = static_cast<int>(cluster / clusters_x_);
+    if (x > 0) {
+        out.push_back(cluster - 1);
+    }
+    if (x + 1 < clusters_x_) {
+        out.push_back(cluster + 1);
+    }
+    if (z > 0) {
+        out.push_back(cluster - clusters_x_);
+    }
+    if (z + 1 < clusters_z_) {
+        out.push_back(cluster + clusters_x_);
+    }
+    return out;
+}
+
+std::uint32_t Nav_hierarchy::node_at(Nav_grid const &grid, Grid_cell c,
+                                     std::uint32_t cluster)
+{
+    auto [it, inserted] = node_of_cell_.try_emplace(grid.index_of(c), 0);
+    if (!inserted) {
+        return it->second;
+    }
+    std::uint32_t id{};
+    if (!free_nodes_.empty()) {
+        id = free_nodes_.back();
+        free_nodes_.pop_back();
+    }
+    else {
+        id = static_cast<std::uint32_t>(nodes_.size());
+        nodes_.emplace_back();
+    }
+    nodes_[id] = Node{.cell = c, .cluster = cluster, .edges = {}};
+    clusters_[cluster].nodes.push_back(id);
+    it->second = id;
+    return id;
+}
+
+void Nav_hierarchy::link_border(Nav_grid const &grid, std::uint32_t a,
+                                std::uint32_t b)
+{
+    auto const &ra = clusters_[a].bounds;
+    auto const &rb = clusters_[b].bounds;
+    bool vertical = b == a + 1; // Otherwise b is below a.
+    int length = vertical ? ra.z1 - ra.z0 : ra.x1 - ra.x0;
+    auto side_a = [&](int i) {
+        return vertical ? Grid_cell{.x = ra.x1 - 1, .z = ra.z0 + i}
+                        : Grid_cell{.x = ra.x0 + i, .z = ra.z1 - 1};
+    };
+    auto side_b = [&](int i) {
+        return vertical ? Grid_cell{.x = rb.x0, .z = rb.z0 + i}
+                        : Grid_cell{.x = rb.x0 + i, .z = rb.z0};
+    };
+    auto open = [&](int i) {
+        return grid.step_cost(side_a(i), side_b(i)).has_value();
+    };
+    auto add_transition = [&](int i) {
+        auto cost = *grid.step_cost(side_a(i), side_b(i));
+        auto na = node_at(grid, side_a(i), a);
+        auto nb = node_at(grid, side_b(i), b);
+        nodes_[na].edges.push_back(Edge{.to = nb, .cost = cost, .route = {}});
+        nodes_[nb].edges.push_back(Edge{.to = na, .cost = cost, .route = {}});
+    };
+
+    for (int i{}; i < length;) {
+        if (!open(i)) {
+            ++i;
+            continue;
+        }
+        int begin = i;
+        while (i < length && open(i)) {
+            ++i;
+        }
+        if (i - begin > long_entrance) {
+            add_transition(begin);
+            add_transition(i - 1);
+        }
+        else {
+            add_transition((begin + i - 1) / 2);
+        }
+    }
+}
+
+void Nav_hierarchy::unlink_border(std::uint32_t a, std::uint32_t b)
+{
+    auto unlink = [&](std::uint32_t from, std::uint32_t to) {
+        for (auto n : clusters_[from].nodes) {
+            std::erase_if(nodes_[n].edges, [&](Edge const &e) {
+                return nodes_[e.to].cluster == to;
+            });
+        }
+    };
+    unlink(a, b);
+    unlink(b, a);
+}
+
+void Nav_hierarchy::connect_cluster(Nav_grid const &grid,
+                                    std::uint32_t cluster)
+{
+    auto &c = clusters_[cluster];
+    for (auto n : c.nodes) {
+        std::erase_if(nodes_[n].edges, [&](Edge const &e) {
+            return nodes_[e.to].cluster == cluster;
+        });
+    }
+    // Portals whose transitions are gone are dead.
+    std::erase_if(c.nodes, [&](std::uint32_t n) {
+        if (!nodes_[n].edges.empty()) {
+            return false;
+        }
+        node_of_cell_.erase(grid.index_of(nodes_[n].cell));
+        free_nodes_.push_back(n);
+        return true;
+    });
+
+    std::vector<Grid_cell> cells;
+    cells.reserve(c.nodes.size());
+    for (auto n : c.nodes) {
+        cells.push_back(nodes_[n].cell);
+    }
+    std::vector<std::vector<Grid_cell>> routes;
+    for (std::size_t i{}; i != c.nodes.size(); ++i) {
+        auto costs = path_costs(grid, cells[i], cells, c.bounds, &routes);
+        for (std::size_t j{}; j != c.nodes.size(); ++j) {
+            if (i != j && costs[j] != std::numeric_limits<float>::infinity()) {
+                nodes_[c.nodes[i]].edges.push_back(
+                    Edge{.to = c.nodes[j],
+                         .cost = costs[j],
+                         .route = std::move(routes[j])});
+            }
+        }
+    }
+}
+
+void Nav_hierarchy::rebuild(Nav_grid const &grid, Cell_rect area)
+{
+    // A changed height also changes the steps into the cells around it, so
+    // the area grows by one cell.
+    auto cx0 = std::max(area.x0 - 1, 0) / cluster_size_;
+    auto cz0 = std::max(area.z0 - 1, 0) / cluster_size_;
+    auto cx1 = (std::min(area.x1 + 1, grid.width()) - 1) / cluster_size_;
+    auto cz1 = (std::min(area.z1 + 1, grid.depth()) - 1) / cluster_size_;
+
+    std::set<std::uint32_t> touched;
+    std::set<std::pair<std::uint32_t, std::uint32_t>> borders;
+    for (auto z = cz0; z <= cz1; ++z) {
+        for (auto x = cx0; x <= cx1; ++x) {
+            auto c = static_cast<std::uint32_t>((z * clusters_x_) + x);
+            touched.insert(c);
+            for (auto n : neighbours_of(c)) {
+                touched.insert(n);
+                borders.insert(std::minmax(c, n));
+            }
+        }
+    }
+    for (auto [a, b] : borders) {
+        unlink_border(a, b);
+    }
+    for (auto [a, b] : borders) {
+        link_border(grid, a, b);
+    }
+    for (auto c : touched) {
+        connect_cluster(grid, c);
+    }
+    spdlog::debug("Nav hierarchy: rebuilt {} clusters, {} portals",
+                  touched.size(), portal_count());
+}
+
+bool Nav_hierarchy::search(Nav_grid const &grid, Grid_cell from,
+                           Grid_cell to, Query &query) const
+{
+    auto from_cluster = cluster_of(from);
+    auto to_cluster = cluster_of(to);
+    if (from_cluster == to_cluster) {
+        query.direct =
+            ::find_path(grid, from, to, clusters_[from_cluster].bounds);
+        if (query.direct) {
+            return true;
+        }
+    }
+
+    // `from` and `to` join the graph through the portals of their clusters,
+    // for the duration of this query only.
+    auto portal_costs = [&](Grid_cell cell, Cluster const &c,
+                            std::vector<std::vector<Grid_cell>> &routes) {
+        std::vector<Grid_cell> cells;
+        cells.reserve(c.nodes.size());
+        for (auto n : c.nodes) {
+            cells.push_back(nodes_[n].cell);
+        }
+        return path_costs(grid, cell, cells, c.bounds, &routes);
+    };
+    auto const &start = clusters_[from_cluster];
+    auto const &goal = clusters_[to_cluster];
+    auto start_costs = portal_costs(from, start, query.start_routes);
+    auto goal_costs = portal_costs(to, goal, query.goal_routes);
+
+    thread_local Abstract_scratch s;
+    auto const goal_id = static_cast<std::uint32_t>(nodes_.size());
+    s.begin(nodes_.size() + 1);
+    auto const gen = s.generation;
+    auto relax = [&](std::uint32_t node, std::uint32_t parent, float g,
+                     Grid_cell cell) {
+        if (s.closed[node] == gen || (s.seen[node] == gen && g >= s.g[node])) {
+            return;
+        }
+        s.seen[node] = gen;
+        s.g[node] = g;
+        s.parent[node] = parent;
+        s.open.push_back(
+            {.f = g + (heuristic_weight * octile_distance(cell, to)),
+             .node = node});
+        std::ranges::push_heap(s.open, std::greater{});
+    };
+
+    for (std::size_t i{}; i != start.nodes.size(); ++i) {
+        if (start_costs[i] != std::numeric_limits<float>::infinity()) {
+            relax(start.nodes[i], no_node, start_costs[i],
+                  nodes_[start.nodes[i]].cell);
+        }
+    }
+    while (!s.open.empty()) {
+        std::ranges::pop_heap(s.open, std::greater{});
+        auto current = s.open.back().node;
+        s.open.pop_back();
+        if (s.closed[current] == gen) {
+            continue;
+        }
+        s.closed[current] = gen;
+
+        if (current == goal_id) {
+            for (auto n = s.parent[goal_id]; n != no_node; n = s.parent[n]) {
+                query.nodes.push_back(n);
+            }
+            std::ranges::reverse(query.nodes);
+            return true;
+        }
+
+        auto const &node = nodes_[current];
+        if (node.cluster == to_cluster) {
+            auto i = std::ranges::find(goal.nodes, current) -
+                     goal.nodes.begin();
+            if (goal_costs[i] != std::numeric_limits<float>::infinity()) {
+                relax(goal_id, current, s.g[current] + goal_costs[i], to);
+            }
+        }
+        for (auto const &e : node.edges) {
+            relax(e.to, current, s.g[current] + e.cost, nodes_[e.to].cell);
+        }
+    }
+    return false;
+}
+
+std::optional<std::vector<Grid_cell>>
+Nav_hierarchy::find_abstract_path(Nav_grid const &grid, Grid_cell from,
+                                  Grid_cell to) const
+{
+    Query query;
+    if (!search(grid, from, to, query)) {
+        return std::nullopt;
+    }
+    std::vector<Grid_cell> route{from};
+    for (auto n : query.nodes) {
+        route.push_back(nodes_[n].cell);
+    }
+    route.push_back(to);
+    return route;
+}
+
+std::optional<std::vector<Grid_cell>>
+Nav_hierarchy::find_path(Nav_grid const &grid, Grid_cell from,
+                         Grid_cell to) const
+{
+    Query query;
+    if (!search(grid, from, to, query)) {
+        return std::nullopt;
+    }
+    if (query.direct) {
+        return std::move(query.direct);
+    }
+
+    // The kept routes of the intra edges, joined by the single steps of the
+    // inter edges, between the legs out of `from` and into `to`.
+    auto portal_index = [&](std::uint32_t node) {
+        auto const &c = clusters_[nodes_[node].cluster];
+        return std::ranges::find(c.nodes, node) - c.nodes.begin();
+    };
+    auto cells = std::move(query.start_routes[portal_index(
+        query.nodes.front())]);
+    for (std::size_t i{1}; i != query.nodes.size(); ++i) {
+        auto const &a = nodes_[query.nodes[i - 1]];
+        auto b = query.nodes[i];
+        if (a.cluster != nodes_[b].cluster) {
+            cells.push_back(nodes_[b].cell);
+            continue;
+        }
+        auto edge = std::ranges::find(a.edges, b, &Edge::to);
+        cells.insert(cells.end(), edge->route.begin() + 1, edge->route.end());
+    }
+    // Steps cost the same both ways, so the leg into `to` is its route to
+    // the last portal, reversed.
+    auto const &last = query.goal_routes[portal_index(query.nodes.back())];
+    cells.insert(cells.end(), last.rbegin() + 1, last.rend());
+    return collapse_collinear(std::move(cells));
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <mb/nav-grid.h>
+
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+/// @brief Abstract graph over a Nav_grid for long routes (HPA*).
+///
+/// The grid is cut into square clusters. Every walkable stretch of a border
+/// between two clusters gets a transition: a pair of facing cells (portals)
+/// linked by an inter edge. Portals of the same cluster are linked by intra
+/// edges whose cost is the cheapest path between them inside the cluster;
+/// that path is kept with the edge. Queries search this small graph and
+/// refine it by joining the kept paths, so only the legs from and to the
+/// query's ends take grid searches, and those within one cluster.
+class Nav_hierarchy {
+  public:
+    explicit Nav_hierarchy(Nav_grid const &grid, int cluster_size = 16);
+
+    // Portals a route from `from` to `to` goes through, both ends included.
+    [[nodiscard]] std::optional<std::vector<Grid_cell>>
+    find_abstract_path(Nav_grid const &grid, Grid_cell from,
+                       Grid_cell to) const;
+
+    // Abstract route refined to grid cells, collapsed like find_path's.
+    [[nodiscard]] std::optional<std::vector<Grid_cell>>
+    find_path(Nav_grid const &grid, Grid_cell from, Grid_cell to) const;
+
+    // Recomputes the portals and edges of the clusters overlapping `area`
+    // (and their neighbours' edges) after the heights there changed.
+    void rebuild(Nav_grid const &grid, Cell_rect area);
+
+    [[nodiscard]] int cluster_size() const
+    {
+        return cluster_size_;
+    }
+    [[nodiscard]] std::size_t portal_count() const
+    {
+        return node_of_cell_.size();
+    }
+
+  private:
+    struct Edge {
+        std::uint32_t to;
+        float cost;
+        // Cells from this node to `to`, collapsed; empty for inter edges,
+        // which are a single step.
+        std::vector<Grid_cell> route;
+    };
+
+    struct Node {
+        Grid_cell cell;
+        std::uint32_t cluster;
+        std::vector<Edge> edges;
+    };
+
+    struct Cluster {
+        Cell_rect bounds;
+        std::vector<std::uint32_t> nodes;
+    };
+
+    // One query's way through the graph.
+    struct Query {
+        // Set when both ends share a cluster and it connects them.
+        std::optional<std::vector<Grid_cell>> direct;
+        std::vector<std::uint32_t> nodes; // portals, from start to goal
+        // Routes from `from` to each portal of its cluster, and from `to`
+        // to each portal of its own.
+        std::vector<std::vector<Grid_cell>> start_routes;
+        std::vector<std::vector<Grid_cell>> goal_routes;
+    };
+
+    [[nodiscard]] bool search(Nav_grid const &grid, Grid_cell from,
+                              Grid_cell to, Query &query) const;
+
+    [[nodiscard]] std::uint32_t cluster_of(Grid_cell c) const;
+    [[nodiscard]] std::vector<std::uint32_t>
+    neighbours_of(std::uint32_t cluster) const;
+    std::uint32_t node_at(Nav_grid const &grid, Grid_cell c,
+                          std::uint32_t cluster);
+    // `a` is the cluster left of or above `b`.
+    void link_border(Nav_grid const &grid, std::uint32_t a, std::uint32_t b);
+    void unlink_border(std::uint32_t a, std::uint32_t b);
+    // Drops portals left without inter edges and recomputes intra edges.
+    void connect_cluster(Nav_grid const &grid, std::uint32_t cluster);
+
+    int cluster_size_;
+    int clusters_x_;
+    int clusters_z_;
+    std::vector<Cluster> clusters_;
+    std::vector<Node> nodes_;
+    std::vector<std::uint32_t> free_nodes_;
+    // Grid cell index -> node.
+    std::unordered_map<std::uint32_t, std::uint32_t> node_of_cell_;
+};
@@ -0,0 +1,138 @@
+#include <mb/path-service.h>
+
+#include <mb/thread-pool.h>
+
+#include <chrono>
+#include <spdlog/spdlog.h>
+
+Path_service::Path_service(Nav_grid grid, Thread_pool &pool,
+                           std::size_t cache_capacity)
+    : pool_{&pool}, cache_capacity_{cache_capacity}
+{
+    Nav_hierarchy hierarchy{grid};
+    nav_ = std::make_shared<Nav_snapshot const>(Nav_snapshot{
+        .grid = std::move(grid), .hierarchy = std::move(hierarchy)});
+}
+
+Path_service::~Path_service()
+{
+    // Searches capture `this`; let them finish before members go away.
+    std::vector<Path_handle> pending;
+    {
+        std::scoped_lock lock{mutex_};
+        for (auto const &[key, handle] : in_flight_) {
+            pending.push_back(handle);
+        }
+        pending.insert(pending.end(), retired_.begin(), retired_.end());
+    }
+    for (auto const &handle : pending) {
+        handle.wait();
+    }
+    auto s = stats();
+    spdlog::info("Path service: {} requests, {} cache hits, {} joined, {} "
+                 "searches ({} hierarchical)",
+                 s.requests, s.cache_hits, s.joined, s.searches,
+                 s.hierarchical);
+}
+
+std::uint64_t Path_service::key_of(Grid_cell from, Grid_cell to) const
+{
+    return (static_cast<std::uint64_t>(grid().index_of(from)) << 32U) |
+           grid().index_of(to);
+}
+
+Path_handle Path_service::request(glm::vec3 from, glm::vec3 to)
+{
+    auto from_cell = grid().cell_of(from);
+    auto to_cell = grid().cell_of(to);
+    auto key = key_of(from_cell, to_cell);
+
+    std::scoped_lock lock{mutex_};
+    ++stats_.requests;
+    if (auto it = cached_.find(key); it != cached_.end()) {
+        ++stats_.cache_hits;
+        lru_.splice(lru_.begin(), lru_, it->second);
+        std::promise<std::shared_ptr<Path const>> ready;
+        ready.set_value(it->second->path);
+        return ready.get_future().share();
+    }
+    if (auto it = in_flight_.find(key); it != in_flight_.end()) {
+        ++stats_.joined;
+        return it->second;
+    }
+
+    ++stats_.searches;
+    // Plain A* is cheaper than the abstract search plus refinement over a
+    // couple of clusters; beyond that it explores far more cells.
+    bool far = octile_distance(from_cell, to_cell) >
+               static_cast<float>(2 * nav_->hierarchy.cluster_size());
+    if (far) {
+        ++stats_.hierarchical;
+    }
+    auto handle =
+        pool_
+            ->submit([this, nav = nav_, version = version_, from_cell,
+                      to_cell, key, far]() -> std::shared_ptr<Path const> {
+                auto cells =
+                    far ? nav->hierarchy.find_path(nav->grid, from_cell,
+                                                   to_cell)
+                        : find_path(nav->grid, from_cell, to_cell);
+                std::shared_ptr<Path> path;
+                if (cells) {
+                    path = std::make_shared<Path>();
+                    path->reserve(cells->size());
+                    for (auto c : *cells) {
+                        path->push_back(nav->grid.position_of(c));
+                    }
+                }
+                insert(key, version, path);
+                return path;
+            })
+            .share();
+    in_flight_.emplace(key, handle);
+    return handle;
+}
+
+void Path_service::edit_terrain(Cell_rect area,
+                                std::function<void(Nav_grid &)> const &edit)
+{
+    auto next = std::make_shared<Nav_snapshot>(*nav_);
+    edit(next->grid);
+    next->hierarchy.rebuild(next->grid, area);
+
+    std::scoped_lock lock{mutex_};
+    nav_ = std::move(next);
+    ++version_;
+    lru_.clear();
+    cached_.clear();
+    std::erase_if(retired_, [](Path_handle const &handle) {
+        return handle.wait_for(std::chrono::seconds{0}) ==
+               std::future_status::ready;
+    });
+    for (auto &[key, handle] : in_flight_) {
+        retired_.push_back(std::move(handle));
+    }
+    in_flight_.clear();
+}
+
+void Path_service::insert(std::uint64_t key, std::uint64_t version,
+                          std::shared_ptr<Path const> path)
+{
+    std::scoped_lock lock{mutex_};
+    if (version != version_) {
+        return;
+    }
+    in_flight_.erase(key);
+    lru_.push_front(Cache_entry{.key = key, .path = std::move(path)});
+    cached_[key] = lru_.begin();
+    if (lru_.size() > cache_capacity_) {
+        cached_.erase(lru_.back().key);
+        lru_.pop_back();
+    }
+}
+
+Path_stats Path_service::stats() const
+{
+    std::scoped_lock lock{mutex_};
+    return stats_;
+}
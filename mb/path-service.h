@@ -0,0 +1,98 @@
+#pragma once
+#include <mb/nav-grid.h>
+#include <mb/nav-hierarchy.h>
+
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <glm/glm.hpp>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+class Thread_pool;
+
+// World space waypoints, ending at the destination cell.
+using Path = std::vector<glm::vec3>;
+
+// Resolves to nullptr if the destination can't be reached.
+using Path_handle = std::shared_future<std::shared_ptr<Path const>>;
+
+struct Path_stats {
+    std::size_t requests;
+    std::size_t cache_hits;
+    std::size_t joined; // requests that joined an identical in-flight search
+    std::size_t searches;
+    std::size_t hierarchical; // searches that went through Nav_hierarchy
+};
+
+/// @brief Answers path requests asynchronously on the thread pool.
+///
+/// Results are kept in an LRU cache keyed by origin and destination cell, and
+/// identical requests made while a search is running share its result.
+/// Routes longer than a couple of clusters are found with the Nav_hierarchy
+/// instead of a plain grid search. Lives in the registry's context so that
+/// systems can reach it.
+class Path_service {
+  public:
+    Path_service(Nav_grid grid, Thread_pool &pool,
+                 std::size_t cache_capacity = 4096);
+    Path_service(Path_service const &) = delete;
+    Path_service(Path_service &&) = delete;
+    Path_service &operator=(Path_service const &) = delete;
+    Path_service &operator=(Path_service &&) = delete;
+    ~Path_service();
+
+    Path_handle request(glm::vec3 from, glm::vec3 to);
+
+    // Applies `edit` to a copy of the grid, rebuilds the hierarchy clusters
+    // overlapping `area` and drops cached routes. Searches already running
+    // finish on the terrain they started with.
+    void edit_terrain(Cell_rect area,
+                      std::function<void(Nav_grid &)> const &edit);
+
+    // Valid until the next edit_terrain.
+    [[nodiscard]] Nav_grid const &grid() const
+    {
+        return nav_->grid;
+    }
+
+    [[nodiscard]] Path_stats stats() const;
+
+  private:
+    // What a search reads; shared with running searches and replaced, never
+    // modified, on edits.
+    struct Nav_snapshot {
+        Nav_grid grid;
+        Nav_hierarchy hierarchy;
+    };
+
+    struct Cache_entry {
+        std::uint64_t key;
+        std::shared_ptr<Path const> path;
+    };
+
+    [[nodiscard]] std::uint64_t key_of(Grid_cell from, Grid_cell to) const;
+    void insert(std::uint64_t key, std::uint64_t version,
+                std::shared_ptr<Path const> path);
+
+    std::shared_ptr<Nav_snapshot const> nav_;
+    // Bumped by every terrain edit, so that searches started before it don't
+    // fill the cache with stale routes.
+    std::uint64_t version_{};
+    Thread_pool *pool_;
+    std::size_t cache_capacity_;
+
+    mutable std::mutex mutex_;
+    // Most recently used first.
+    std::list<Cache_entry> lru_;
+    std::unordered_map<std::uint64_t, std::list<Cache_entry>::iterator>
+        cached_;
+    std::unordered_map<std::uint64_t, Path_handle> in_flight_;
+    // Searches started before the last terrain edit, still to be waited for
+    // on destruction.
+    std::vector<Path_handle> retired_;
+    Path_stats stats_{};
+};
@@ -1,25 +1,36 @@
 #include <mb/systems.h>
 
+#include <mb/flow-field.h>
+#include <mb/path-service.h>
+
+#include <chrono>
 #include <ranges>
 
 /// @brief Grants velocity to those who have will to pathing to somewhere, but
-/// remove pathing for arrived and losing target views.
+/// remove pathing for arrived, unreachable and losing target views.
+///
+/// Chasers follow the target's flow field while they are inside it. Other
+/// routes come from the Path_service in the registry context; while a route
+/// is being searched, an entity keeps its current heading.
 ///
-/// @note Depends on perception_system
+/// @note Depends on flow_field_system
 void pathing_system(entt::registry &reg)
 {
     constexpr double pathing_eps{0.5};
+    auto &paths = reg.ctx().get<Path_service>();
+    auto const &fields = reg.ctx().get<Flow_fields>();
+    auto head_for = [](Velocity &vel, glm::vec3 from, glm::vec3 to) {
+        glm::vec3 dir{to.x - from.x, 0, to.z - from.z};
+        vel.dir = glm::length(dir) > 1e-5 ? glm::normalize(dir) : glm::vec3{};
+    };
     auto pathings = reg.view<Army, Pathing, Position, Velocity>();
     for (auto [e, army, pathing, pos, vel] : pathings.each()) {
         // Pathing to x,z
         glm::vec3 dest;
         if (pathing.target_is_entity) {
-            // Lost view of target
-            if (!std::ranges::contains(army.perception.viewable_entity,
-                                       pathing.dest_e)) {
-                spdlog::info("{} lost view of {}, stop pathing",
-                             static_cast<int>(e),
-                             static_cast<int>(pathing.dest_e));
+            // Losing view of the target is handled on Left_view; this only
+            // catches targets destroyed since perception last ran.
+            if (!reg.valid(pathing.dest_e)) {
                 reg.remove<Pathing>(e);
                 continue;
             }
@@ -29,17 +40,60 @@ void pathing_system(entt::registry &reg)
             dest = pathing.dest_pos;
         }
         if (glm::distance(glm::vec2{dest.x, dest.z},
-                          glm::vec2{pos.value.x, pos.value.z}) > pathing_eps) {
-            spdlog::debug("pathing: {} -> ({}, {}, {})", static_cast<int>(e),
-                          dest.x, dest.y, dest.z);
-            vel.dir = glm::normalize(dest - pos.value);
-        }
-        else {
+                          glm::vec2{pos.value.x, pos.value.z}) <= pathing_eps) {
             spdlog::debug("pathing: {} arrived ({}, {}, {})",
                           static_cast<int>(e), pos.value.x, pos.value.y,
                           pos.value.z);
             vel.dir = {};
             reg.remove<Pathing>(e);
+            continue;
+        }
+
+        auto const &grid = paths.grid();
+        auto goal = grid.cell_of(dest);
+        if (pathing.target_is_entity) {
+            auto field = fields.by_target.find(pathing.dest_e);
+            auto next = field != fields.by_target.end()
+                            ? field->second.next(grid.cell_of(pos.value))
+                            : std::nullopt;
+            if (next) {
+                head_for(vel, pos.value,
+                         *next == goal ? dest : grid.position_of(*next));
+                continue;
+            }
+        }
+
+        // (Re)route when the destination moved to another cell.
+        if (!pathing.route.valid() || goal != pathing.route_goal) {
+            pathing.route = paths.request(pos.value, dest);
+            pathing.route_goal = goal;
+            pathing.next_waypoint = 1; // Waypoint 0 is where we stand.
+        }
+        if (pathing.route.wait_for(std::chrono::seconds{0}) !=
+            std::future_status::ready) {
+            continue;
+        }
+        auto const &route = pathing.route.get();
+        if (route == nullptr) {
+            spdlog::info("pathing: {} can't reach ({}, {}, {})",
+                         static_cast<int>(e), dest.x, dest.y, dest.z);
+            vel.dir = {};
+            reg.remove<Pathing>(e);
+            continue;
+        }
+
+        auto &next = pathing.next_waypoint;
+        while (next < route->size() &&
+               glm::distance(glm::vec2{(*route)[next].x, (*route)[next].z},
+                             glm::vec2{pos.value.x, pos.value.z}) <=
+                   pathing_eps) {
+            ++next;
         }
+        // The last waypoint is only the destination's cell; head for the
+        // exact destination instead.
+        auto target = next + 1 < route->size() ? (*route)[next] : dest;
+        spdlog::debug("pathing: {} -> ({}, {}, {})", static_cast<int>(e),
+                      target.x, target.y, target.z);
+        head_for(vel, pos.value, target);
     }
 }
@@ -1,18 +1,116 @@
 #include <mb/components.h>
+#include <mb/events.h>
+#include <mb/frame-arena.h>
 #include <mb/systems.h>
 
-void perception_system(entt::registry &registry)
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory_resource>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// Armies can see at most this far, so only those in the same or an adjacent
+// cell of this size need checking.
+constexpr float perception_cell{view_dist + view_hysteresis};
+
+std::uint64_t cell_key(std::int32_t x, std::int32_t z)
+{
+    return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(x)) << 32U) |
+           static_cast<std::uint32_t>(z);
+}
+
+std::int32_t cell_coord(float v)
+{
+    return static_cast<std::int32_t>(std::floor(v / perception_cell));
+}
+
+} // namespace
+
+/// @brief Keeps every army's sorted set of armies in view, and tells the
+/// dispatcher who entered or left it.
+///
+/// Armies enter a view within view_dist but only leave it beyond view_dist +
+/// view_hysteresis, so that one walking along the edge doesn't flicker in and
+/// out. Events are queued while sets are updated and delivered at the end.
+void perception_system(entt::registry &registry, entt::dispatcher &dispatcher)
 {
+    auto &arena = registry.ctx().get<Frame_arena>();
     auto armies = registry.view<Army, Position>();
-    for (auto [e, army1, pos1] : armies.each()) {
-        army1.perception.viewable_entity.clear();
-
-        for (auto [e2, army2, pos2] : armies.each()) {
-            auto dist = glm::distance(glm::vec2{pos1.value.x, pos1.value.z},
-                                      glm::vec2{pos2.value.x, pos2.value.z});
-            if (dist < view_dist) {
-                army1.perception.viewable_entity.push_back(e2);
+    std::pmr::vector<std::pair<std::uint64_t, entt::entity>> buckets{&arena};
+    buckets.reserve(armies.size_hint());
+    std::pmr::vector<entt::entity> seen{&arena};
+    for (auto [e, army, pos] : armies.each()) {
+        buckets.emplace_back(
+            cell_key(cell_coord(pos.value.x), cell_coord(pos.value.z)), e);
+    }
+    std::ranges::sort(buckets);
+
+    for (auto [e, army, pos] : armies.each()) {
+        auto &viewable = army.perception.viewable_entity;
+        seen.clear();
+        auto cx = cell_coord(pos.value.x);
+        auto cz = cell_coord(pos.value.z);
+        for (auto z = cz - 1; z <= cz + 1; ++z) {
+            for (auto x = cx - 1; x <= cx + 1; ++x) {
+                auto key = cell_key(x, z);
+                auto first = std::ranges::lower_bound(
+                    buckets, key, {},
+                    &std::pair<std::uint64_t, entt::entity>::first);
+                for (auto it = first;
+                     it != buckets.end() && it->first == key; ++it) {
+                    auto other = it->second;
+                    if (other == e) {
+                        continue;
+                    }
+                    auto const &opos = armies.get<Position>(other).value;
+                    auto dist =
+                        glm::distance(glm::vec2{pos.value.x, pos.value.z},
+                                      glm::vec2{opos.x, opos.z});
+                    bool was_seen =
+                        std::ranges::binary_search(viewable, other);
+                    if (dist < view_dist ||
+                        (was_seen && dist <= view_dist + view_hysteresis)) {
+                        seen.push_back(other);
+                    }
+                }
             }
         }
+        std::ranges::sort(seen);
+        if (std::ranges::equal(seen, viewable)) {
+            continue;
+        }
+
+        // Both sides are sorted; walk them together.
+        auto *visibility = registry.try_get<Visibility>(e);
+        auto old_it = viewable.begin();
+        auto new_it = seen.begin();
+        while (old_it != viewable.end() || new_it != seen.end()) {
+            if (new_it == seen.end() ||
+                (old_it != viewable.end() && *old_it < *new_it)) {
+                if (visibility != nullptr) {
+                    visibility->visible.reset(*old_it);
+                }
+                dispatcher.enqueue(Left_view{
+                    .registry = &registry, .viewer = e, .seen = *old_it++});
+            }
+            else if (old_it == viewable.end() || *new_it < *old_it) {
+                if (visibility != nullptr) {
+                    visibility->visible.set(*new_it);
+                }
+                dispatcher.enqueue(Entered_view{
+                    .registry = &registry, .viewer = e, .seen = *new_it++});
+            }
+            else {
+                ++old_it;
+                ++new_it;
+            }
+        }
+        viewable.assign(seen.begin(), seen.end());
     }
+
+    dispatcher.update<Left_view>();
+    dispatcher.update<Entered_view>();
 }
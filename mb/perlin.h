@@ -3,22 +3,27 @@
 // 参考 Ken Perlin 原始算法
 
 #pragma once
+#include <mb/random.h>
+
 #include <algorithm>
 #include <array>
 #include <cmath>
 #include <glm/glm.hpp>
 #include <numeric>
-#include <random>
 #include <vector>
 
 class Perlin {
   public:
-    Perlin()
+    explicit Perlin(Random_stream rng)
     {
         // 初始化随机置换表
         p.resize(256);
         std::iota(p.begin(), p.end(), 0);
-        std::shuffle(p.begin(), p.end(), std::mt19937{std::random_device{}()});
+        // Fisher-Yates by hand: std::shuffle differs between standard
+        // libraries, and the terrain must not.
+        for (int i = 255; i > 0; --i) {
+            std::swap(p[i], p[rng.uniform_int(0, i)]);
+        }
         p.insert(p.end(), p.begin(), p.end()); // 512
     }
 
@@ -0,0 +1,678 @@
+#include <mb/prototype-defs.h>
+
+#include <mb/components.h>
+#include <mb/entity-factory.h>
+#include <mb/model.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <optional>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace {
+
+constexpr std::array<char, 4> blob_magic{'M', 'B', 'P', 'D'};
+// Bump whenever a record or the component set changes, so that caches
+// written by older builds are recompiled.
+constexpr std::uint32_t blob_version{1};
+
+// Stands for no name or no troop.
+constexpr std::uint32_t no_id{~std::uint32_t{}};
+
+struct Blob_range {
+    std::uint32_t offset; // bytes from the start of the blob
+    std::uint32_t count;  // records
+};
+
+struct Blob_header {
+    std::array<char, 4> magic;
+    std::uint32_t version;
+    Blob_range names;
+    Blob_range chars; // name characters; count is in bytes
+    Blob_range troops;
+    Blob_range prototypes;
+    Blob_range components;
+};
+
+struct Name_record {
+    std::uint32_t offset; // into the characters
+    std::uint32_t size;
+};
+
+struct Troop_record {
+    std::uint32_t name;
+    std::int32_t armor;
+    std::int32_t damage;
+    float speed;
+    float upkeep;
+    std::int32_t tier;
+    std::uint32_t upgrade; // troop record, or no_id
+};
+
+struct Prototype_record {
+    std::uint32_t name;
+    std::uint32_t first_component;
+    std::uint32_t component_count;
+};
+
+enum class Component_kind : std::uint32_t {
+    Local_player_tag,
+    Visibility,
+    Ai_tag,
+    Ai_cooldown,
+    Army,
+    Collidable,
+    Position,
+    Velocity,
+    Renderable,
+    Transform,
+    Animator,
+    Town_tag,
+    Item,
+};
+
+constexpr std::size_t max_fields{3};
+
+// Each field holds a float's bits or an id, as its schema says.
+struct Component_record {
+    Component_kind kind;
+    std::array<std::uint32_t, max_fields> fields;
+};
+
+enum class Field_type : std::uint8_t { Number, Name, Troop };
+
+struct Field_schema {
+    std::string_view key; // empty for unused slots
+    Field_type type;
+};
+
+struct Component_schema {
+    std::string_view name;
+    Component_kind kind;
+    std::array<Field_schema, max_fields> fields;
+};
+
+// Components a prototype may list, in Component_kind order, and their fields
+// in record order.
+constexpr std::array component_schemas{
+    Component_schema{"Local_player_tag", Component_kind::Local_player_tag, {}},
+    Component_schema{"Visibility", Component_kind::Visibility, {}},
+    Component_schema{"Ai_tag", Component_kind::Ai_tag, {}},
+    Component_schema{"Ai_cooldown",
+                     Component_kind::Ai_cooldown,
+                     {{{"total", Field_type::Number}}}},
+    Component_schema{"Army",
+                     Component_kind::Army,
+                     {{{"troop", Field_type::Troop},
+                       {"size", Field_type::Number},
+                       {"money", Field_type::Number}}}},
+    Component_schema{"Collidable", Component_kind::Collidable, {}},
+    Component_schema{"Position", Component_kind::Position, {}},
+    Component_schema{"Velocity",
+                     Component_kind::Velocity,
+                     {{{"speed", Field_type::Number}}}},
+    Component_schema{"Renderable",
+                     Component_kind::Renderable,
+                     {{{"model", Field_type::Name},
+                       {"shader", Field_type::Name}}}},
+    Component_schema{"Transform",
+                     Component_kind::Transform,
+                     {{{"scale", Field_type::Number}}}},
+    Component_schema{"Animator", Component_kind::Animator, {}},
+    Component_schema{"Town_tag", Component_kind::Town_tag, {}},
+    Component_schema{"Item",
+                     Component_kind::Item,
+                     {{{"name", Field_type::Name},
+                       {"price", Field_type::Number}}}},
+};
+
+Component_schema const &schema_of(Component_kind kind)
+{
+    return component_schemas[static_cast<std::size_t>(kind)];
+}
+
+std::vector<std::string_view> split(std::string_view line)
+{
+    std::vector<std::string_view> tokens;
+    while (true) {
+        auto begin = line.find_first_not_of(" \t\r");
+        if (begin == std::string_view::npos) {
+            return tokens;
+        }
+        line.remove_prefix(begin);
+        auto end = std::min(line.find_first_of(" \t\r"), line.size());
+        tokens.push_back(line.substr(0, end));
+        line.remove_prefix(end);
+    }
+}
+
+// Turns a definition file into blob records.
+class Compiler {
+  public:
+    explicit Compiler(std::filesystem::path path) : path_{std::move(path)} {}
+
+    std::vector<std::byte> run()
+    {
+        std::ifstream in{path_};
+        if (!in) {
+            spdlog::error("Unable to open prototype definitions {}",
+                          path_.string());
+            throw std::runtime_error("check last error");
+        }
+        std::string text;
+        bool in_prototype{};
+        while (std::getline(in, text)) {
+            ++line_;
+            auto tokens = split(std::string_view{text}.substr(
+                0, std::min(text.find('#'), text.size())));
+            if (tokens.empty()) {
+                continue;
+            }
+            if (tokens[0] == "troop" && !in_prototype) {
+                add_troop(tokens);
+            }
+            else if (tokens[0] == "prototype" && !in_prototype) {
+                add_prototype(tokens);
+                in_prototype = true;
+            }
+            else if (tokens[0] == "end" && in_prototype) {
+                in_prototype = false;
+            }
+            else if (in_prototype) {
+                add_component(tokens);
+            }
+            else {
+                fail("unexpected '{}'", tokens[0]);
+            }
+        }
+        if (in_prototype) {
+            fail("missing 'end'");
+        }
+        resolve_troops();
+        return write();
+    }
+
+  private:
+    // A troop named before it may be defined, and where its id goes.
+    struct Troop_ref {
+        bool in_troop; // else in a component
+        std::size_t record;
+        std::size_t field;
+        std::uint32_t name;
+        int line;
+    };
+
+    template <typename... Args>
+    [[noreturn]] void fail(spdlog::format_string_t<Args...> format,
+                           Args &&...args) const
+    {
+        spdlog::error("{}:{}: {}", path_.string(), line_,
+                      fmt::format(format, std::forward<Args>(args)...));
+        throw std::runtime_error("check last error");
+    }
+
+    std::uint32_t intern(std::string_view name)
+    {
+        auto [it, added] = name_ids_.try_emplace(
+            std::string{name}, static_cast<std::uint32_t>(names_.size()));
+        if (added) {
+            names_.emplace_back(name);
+        }
+        return it->second;
+    }
+
+    template <typename T>
+    T number(std::string_view value) const
+    {
+        T result{};
+        auto [end, error] =
+            std::from_chars(value.data(), value.data() + value.size(), result);
+        if (error != std::errc{} || end != value.data() + value.size()) {
+            fail("'{}' is not a number", value);
+        }
+        return result;
+    }
+
+    // Splits `key=value`.
+    std::pair<std::string_view, std::string_view>
+    field(std::string_view token) const
+    {
+        auto eq = token.find('=');
+        if (eq == std::string_view::npos || eq == 0) {
+            fail("expected <field>=<value>, got '{}'", token);
+        }
+        return {token.substr(0, eq), token.substr(eq + 1)};
+    }
+
+    void add_troop(std::span<std::string_view const> tokens)
+    {
+        if (tokens.size() < 2) {
+            fail("troop needs a name");
+        }
+        auto name = intern(tokens[1]);
+        if (!troop_of_.try_emplace(name, troops_.size()).second) {
+            fail("troop '{}' is defined twice", tokens[1]);
+        }
+        Troop_record troop{.name = name,
+                           .armor = 0,
+                           .damage = 0,
+                           .speed = 0,
+                           .upkeep = 0,
+                           .tier = 0,
+                           .upgrade = no_id};
+        for (auto token : tokens.subspan(2)) {
+            auto [key, value] = field(token);
+            if (key == "armor") {
+                troop.armor = number<std::int32_t>(value);
+            }
+            else if (key == "damage") {
+                troop.damage = number<std::int32_t>(value);
+            }
+            else if (key == "speed") {
+                troop.speed = number<float>(value);
+            }
+            else if (key == "upkeep") {
+                troop.upkeep = number<float>(value);
+            }
+            else if (key == "tier") {
+                troop.tier = number<std::int32_t>(value);
+            }
+            else if (key == "upgrade") {
+                refs_.push_back(Troop_ref{.in_troop = true,
+                                          .record = troops_.size(),
+                                          .field = 0,
+                                          .name = intern(value),
+                                          .line = line_});
+            }
+            else {
+                fail("troops have no '{}'", key);
+            }
+        }
+        troops_.push_back(troop);
+    }
+
+    void add_prototype(std::span<std::string_view const> tokens)
+    {
+        if (tokens.size() != 2) {
+            fail("expected 'prototype <name>'");
+        }
+        auto name = intern(tokens[1]);
+        if (std::ranges::find(prototypes_, name, &Prototype_record::name) !=
+            prototypes_.end()) {
+            fail("prototype '{}' is defined twice", tokens[1]);
+        }
+        prototypes_.push_back(Prototype_record{
+            .name = name,
+            .first_component = static_cast<std::uint32_t>(components_.size()),
+            .component_count = 0});
+    }
+
+    void add_component(std::span<std::string_view const> tokens)
+    {
+        auto const *schema = std::ranges::find(component_schemas, tokens[0],
+                                               &Component_schema::name);
+        if (schema == component_schemas.end()) {
+            fail("unknown component '{}'", tokens[0]);
+        }
+        Component_record component{.kind = schema->kind, .fields = {}};
+        for (std::size_t i{}; i != max_fields; ++i) {
+            component.fields[i] = schema->fields[i].type == Field_type::Number
+                                      ? std::bit_cast<std::uint32_t>(0.0F)
+                                      : no_id;
+        }
+        for (auto token : tokens.subspan(1)) {
+            auto [key, value] = field(token);
+            auto const *slot = std::ranges::find(schema->fields, key,
+                                                 &Field_schema::key);
+            if (key.empty() || slot == schema->fields.end()) {
+                fail("{} has no '{}'", schema->name, key);
+            }
+            auto i = static_cast<std::size_t>(slot - schema->fields.begin());
+            switch (slot->type) {
+            case Field_type::Number:
+                component.fields[i] =
+                    std::bit_cast<std::uint32_t>(number<float>(value));
+                break;
+            case Field_type::Name:
+                component.fields[i] = intern(value);
+                break;
+            case Field_type::Troop:
+                refs_.push_back(Troop_ref{.in_troop = false,
+                                          .record = components_.size(),
+                                          .field = i,
+                                          .name = intern(value),
+                                          .line = line_});
+                break;
+            }
+        }
+        components_.push_back(component);
+        ++prototypes_.back().component_count;
+    }
+
+    void resolve_troops()
+    {
+        for (auto const &ref : refs_) {
+            auto it = troop_of_.find(ref.name);
+            if (it == troop_of_.end()) {
+                line_ = ref.line;
+                fail("unknown troop '{}'", names_[ref.name]);
+            }
+            auto id = static_cast<std::uint32_t>(it->second);
+            if (ref.in_troop) {
+                troops_[ref.record].upgrade = id;
+            }
+            else {
+                components_[ref.record].fields[ref.field] = id;
+            }
+        }
+    }
+
+    std::vector<std::byte> write() const
+    {
+        std::vector<std::byte> bytes(sizeof(Blob_header));
+        auto append = [&](auto const &records) {
+            using Record = std::ranges::range_value_t<decltype(records)>;
+            // Every record is made of 4-byte fields.
+            bytes.resize((bytes.size() + 3) & ~std::size_t{3});
+            Blob_range range{.offset = static_cast<std::uint32_t>(bytes.size()),
+                             .count = static_cast<std::uint32_t>(
+                                 std::ranges::size(records))};
+            bytes.resize(bytes.size() + (sizeof(Record) * range.count));
+            std::memcpy(bytes.data() + range.offset, std::ranges::data(records),
+                        sizeof(Record) * range.count);
+            return range;
+        };
+
+        std::vector<Name_record> names;
+        std::string chars;
+        for (auto const &name : names_) {
+            names.push_back(
+                Name_record{.offset = static_cast<std::uint32_t>(chars.size()),
+                            .size = static_cast<std::uint32_t>(name.size())});
+            chars += name;
+        }
+        Blob_header header{.magic = blob_magic,
+                           .version = blob_version,
+                           .names = append(names),
+                           .chars = append(chars),
+                           .troops = append(troops_),
+                           .prototypes = append(prototypes_),
+                           .components = append(components_)};
+        std::memcpy(bytes.data(), &header, sizeof(header));
+        return bytes;
+    }
+
+    std::filesystem::path path_;
+    int line_{};
+    std::vector<std::string> names_;
+    std::unordered_map<std::string, std::uint32_t> name_ids_;
+    std::vector<Troop_record> troops_;
+    std::unordered_map<std::uint32_t, std::size_t> troop_of_; // by name
+    std::vector<Prototype_record> prototypes_;
+    std::vector<Component_record> components_;
+    std::vector<Troop_ref> refs_;
+};
+
+std::optional<std::vector<std::byte>>
+read_file(std::filesystem::path const &path)
+{
+    std::ifstream in{path, std::ios::binary | std::ios::ate};
+    if (!in) {
+        return std::nullopt;
+    }
+    std::vector<std::byte> bytes(static_cast<std::size_t>(in.tellg()));
+    in.seekg(0);
+    in.read(reinterpret_cast<char *>(bytes.data()),
+            static_cast<std::streamsize>(bytes.size()));
+    if (!in) {
+        return std::nullopt;
+    }
+    return bytes;
+}
+
+} // namespace
+
+template <typename T>
+T Prototype_defs::record(std::uint32_t offset, std::size_t i) const
+{
+    T result;
+    std::memcpy(&result, bytes_.data() + offset + (i * sizeof(T)), sizeof(T));
+    return result;
+}
+
+Prototype_defs::Prototype_defs(std::vector<std::byte> bytes)
+    : bytes_{std::move(bytes)}
+{
+    auto bad = [](std::string_view what) {
+        spdlog::error("Prototype blob: {}", what);
+        throw std::runtime_error("check last error");
+    };
+    if (bytes_.size() < sizeof(Blob_header)) {
+        bad("too short");
+    }
+    auto header = record<Blob_header>(0, 0);
+    if (header.magic != blob_magic || header.version != blob_version) {
+        bad("wrong format or version");
+    }
+    auto fits = [&](Blob_range range, std::size_t record_size) {
+        return std::uint64_t{range.offset} +
+                   (std::uint64_t{range.count} * record_size) <=
+               bytes_.size();
+    };
+    if (!fits(header.names, sizeof(Name_record)) || !fits(header.chars, 1) ||
+        !fits(header.troops, sizeof(Troop_record)) ||
+        !fits(header.prototypes, sizeof(Prototype_record)) ||
+        !fits(header.components, sizeof(Component_record))) {
+        bad("truncated");
+    }
+
+    auto names = header.names.count;
+    for (std::uint32_t i{}; i != names; ++i) {
+        auto name = record<Name_record>(header.names.offset, i);
+        if (std::uint64_t{name.offset} + name.size > header.chars.count) {
+            bad("name out of range");
+        }
+    }
+    auto troops = header.troops.count;
+    for (std::uint32_t i{}; i != troops; ++i) {
+        auto troop = record<Troop_record>(header.troops.offset, i);
+        if (troop.name >= names ||
+            (troop.upgrade != no_id && troop.upgrade >= troops)) {
+            bad("troop out of range");
+        }
+    }
+    for (std::uint32_t i{}; i != header.prototypes.count; ++i) {
+        auto proto = record<Prototype_record>(header.prototypes.offset, i);
+        if (proto.name >= names ||
+            std::uint64_t{proto.first_component} + proto.component_count >
+                header.components.count) {
+            bad("prototype out of range");
+        }
+    }
+    for (std::uint32_t i{}; i != header.components.count; ++i) {
+        auto component = record<Component_record>(header.components.offset, i);
+        if (static_cast<std::size_t>(component.kind) >=
+            component_schemas.size()) {
+            bad("unknown component");
+        }
+        auto const &schema = schema_of(component.kind);
+        for (std::size_t f{}; f != max_fields; ++f) {
+            auto id = component.fields[f];
+            auto type = schema.fields[f].type;
+            if (!schema.fields[f].key.empty() && id != no_id &&
+                ((type == Field_type::Name && id >= names) ||
+                 (type == Field_type::Troop && id >= troops))) {
+                bad("component field out of range");
+            }
+        }
+    }
+}
+
+Prototype_defs Prototype_defs::compile(std::filesystem::path const &text)
+{
+    return Prototype_defs{Compiler{text}.run()};
+}
+
+Prototype_defs Prototype_defs::load(std::filesystem::path const &text,
+                                    std::filesystem::path const &cache)
+{
+    std::error_code ec;
+    auto cache_time = std::filesystem::last_write_time(cache, ec);
+    auto fresh = !ec;
+    if (fresh) {
+        // Without the text (as shipped), the cache is all there is.
+        auto text_time = std::filesystem::last_write_time(text, ec);
+        fresh = ec || cache_time >= text_time;
+    }
+    if (fresh) {
+        if (auto bytes = read_file(cache)) {
+            try {
+                Prototype_defs defs{std::move(*bytes)};
+                spdlog::info("Loaded prototypes from {}", cache.string());
+                return defs;
+            }
+            catch (std::runtime_error const &) {
+                spdlog::warn("Recompiling {}", text.string());
+            }
+        }
+    }
+
+    auto defs = compile(text);
+    std::ofstream out{cache, std::ios::binary | std::ios::trunc};
+    out.write(reinterpret_cast<char const *>(defs.bytes_.data()),
+              static_cast<std::streamsize>(defs.bytes_.size()));
+    if (!out) {
+        spdlog::warn("Unable to write prototype cache {}", cache.string());
+    }
+    spdlog::info("Compiled prototypes from {}", text.string());
+    return defs;
+}
+
+std::string_view Prototype_defs::name(std::uint32_t id) const
+{
+    auto header = record<Blob_header>(0, 0);
+    auto name = record<Name_record>(header.names.offset, id);
+    return {reinterpret_cast<char const *>(bytes_.data()) +
+                header.chars.offset + name.offset,
+            name.size};
+}
+
+void Prototype_defs::install(Troop_roster &roster, Entity_factory &factory,
+                             Prototype_assets const &assets) const
+{
+    auto header = record<Blob_header>(0, 0);
+    auto first_troop = roster.size();
+    auto troop_id = [&](std::uint32_t id) {
+        return id == no_id ? no_troop : first_troop + id;
+    };
+
+    std::vector<Troop> troops;
+    troops.reserve(header.troops.count);
+    for (std::uint32_t i{}; i != header.troops.count; ++i) {
+        auto t = record<Troop_record>(header.troops.offset, i);
+        troops.push_back(Troop{.armor = t.armor,
+                               .weapon_damage = t.damage,
+                               .speed = t.speed,
+                               .upkeep = t.upkeep,
+                               .tier = t.tier,
+                               .upgrade = troop_id(t.upgrade)});
+    }
+    roster.load(troops);
+
+    for (std::uint32_t i{}; i != header.prototypes.count; ++i) {
+        auto p = record<Prototype_record>(header.prototypes.offset, i);
+        auto proto_name = std::string{name(p.name)};
+        auto &proto = factory.register_prototype(proto_name);
+        auto bad = [&](std::string_view what) {
+            spdlog::error("Prototype {}: {}", proto_name, what);
+            throw std::runtime_error("check last error");
+        };
+
+        std::shared_ptr<Model> model;
+        std::optional<Army> army;
+        std::optional<float> speed;
+        for (std::uint32_t k{}; k != p.component_count; ++k) {
+            auto c = record<Component_record>(header.components.offset,
+                                              p.first_component + k);
+            auto number = [&](std::size_t f) {
+                return std::bit_cast<float>(c.fields[f]);
+            };
+            auto text = [&](std::size_t f) {
+                if (c.fields[f] == no_id) {
+                    bad(fmt::format("{} needs its {}", schema_of(c.kind).name,
+                                    schema_of(c.kind).fields[f].key));
+                }
+                return std::string{name(c.fields[f])};
+            };
+            switch (c.kind) {
+            case Component_kind::Local_player_tag:
+                proto.with(Local_player_tag{});
+                break;
+            case Component_kind::Visibility:
+                proto.with(Visibility{});
+                break;
+            case Component_kind::Ai_tag:
+                proto.with(Ai_tag{});
+                break;
+            case Component_kind::Ai_cooldown:
+                proto.with(Ai_cooldown{.timer = 0, .total = number(0)});
+                break;
+            case Component_kind::Army:
+                army = Army{.stacks{}, .perception{}, .money = number(2)};
+                if (c.fields[0] != no_id) {
+                    army->stacks.push_back(Troop_stack{
+                        .size = static_cast<std::size_t>(number(1)),
+                        .troop_id = troop_id(c.fields[0])});
+                }
+                proto.with(*army);
+                break;
+            case Component_kind::Collidable:
+                proto.with(Collidable{});
+                break;
+            case Component_kind::Position:
+                proto.with(Position{});
+                break;
+            case Component_kind::Velocity:
+                speed = number(0);
+                break;
+            case Component_kind::Renderable:
+                model = assets.model(text(0));
+                proto.with(Renderable{.model = model,
+                                      .shader = assets.shader(text(1))});
+                break;
+            case Component_kind::Transform:
+                proto.with(Transform{.scale = glm::vec3(number(0))});
+                break;
+            case Component_kind::Animator:
+                if (!model) {
+                    bad("Animator needs a Renderable before it");
+                }
+                if (model->is_animated()) {
+                    proto.with(make_animator(model->skeleton()));
+                }
+                break;
+            case Component_kind::Town_tag:
+                proto.with(comp::Town_tag{});
+                break;
+            case Component_kind::Item:
+                proto.with(comp::Item{.name = text(0), .price = number(1)});
+                break;
+            }
+        }
+        // Armies move as fast as their slowest troop unless told otherwise.
+        if (speed) {
+            if (*speed == 0 && army) {
+                speed = army_speed(*army, roster);
+            }
+            proto.with(Velocity{.dir = {}, .speed = *speed});
+        }
+    }
+    spdlog::info("Installed {} troops and {} prototypes", header.troops.count,
+                 header.prototypes.count);
+}
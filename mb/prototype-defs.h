@@ -0,0 +1,60 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class Entity_factory;
+class Model;
+class Shader_program;
+class Troop_roster;
+
+// Resolves the asset names prototypes refer to.
+struct Prototype_assets {
+    std::function<std::shared_ptr<Model>(std::string const &)> model;
+    std::function<Shader_program const *(std::string const &)> shader;
+};
+
+/// @brief Troops and entity prototypes, compiled from a text definition file
+/// into a flat binary blob.
+///
+/// The blob holds a header, a table of interned names and fixed-size records
+/// for troops, prototypes and their components. Component types and troop
+/// references are resolved to ids when compiling, so loading a cached blob
+/// is one read plus bounds checks; no text is parsed. See
+/// prototypes/world.proto for the text format.
+class Prototype_defs {
+  public:
+    // Parses the definitions in `text`.
+    static Prototype_defs compile(std::filesystem::path const &text);
+
+    // Reads `cache` if it is at least as new as `text` and valid; otherwise
+    // compiles `text` and rewrites `cache`.
+    static Prototype_defs load(std::filesystem::path const &text,
+                               std::filesystem::path const &cache);
+
+    // Appends the troops to `roster` and registers every prototype with
+    // `factory`.
+    void install(Troop_roster &roster, Entity_factory &factory,
+                 Prototype_assets const &assets) const;
+
+    [[nodiscard]] std::span<std::byte const> bytes() const
+    {
+        return bytes_;
+    }
+
+  private:
+    // Throws if `bytes` isn't a well-formed blob.
+    explicit Prototype_defs(std::vector<std::byte> bytes);
+
+    [[nodiscard]] std::string_view name(std::uint32_t id) const;
+    template <typename T>
+    [[nodiscard]] T record(std::uint32_t offset, std::size_t i) const;
+
+    std::vector<std::byte> bytes_;
+};
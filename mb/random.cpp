@@ -0,0 +1,149 @@
+#include <mb/random.h>
+
+#include <mb/simd.h>
+
+namespace {
+
+constexpr std::uint32_t philox_m0{0xD2511F53};
+constexpr std::uint32_t philox_m1{0xCD9E8D57};
+constexpr std::uint32_t philox_w0{0x9E3779B9};
+constexpr std::uint32_t philox_w1{0xBB67AE85};
+constexpr int philox_rounds{10};
+
+// 2^-24: the top 24 bits of a word make an exactly representable float.
+constexpr float word_to_unit{1.0F / 16777216.0F};
+
+std::array<std::uint32_t, 4> philox(std::array<std::uint32_t, 4> c,
+                                    std::array<std::uint32_t, 2> k)
+{
+    for (int round{}; round != philox_rounds; ++round) {
+        auto p0 = static_cast<std::uint64_t>(philox_m0) * c[0];
+        auto p1 = static_cast<std::uint64_t>(philox_m1) * c[2];
+        c = {static_cast<std::uint32_t>(p1 >> 32U) ^ c[1] ^ k[0],
+             static_cast<std::uint32_t>(p1),
+             static_cast<std::uint32_t>(p0 >> 32U) ^ c[3] ^ k[1],
+             static_cast<std::uint32_t>(p0)};
+        k[0] += philox_w0;
+        k[1] += philox_w1;
+    }
+    return c;
+}
+
+#ifdef MB_SSE2
+// 32x32 -> 64 bit products of four lanes, split into high and low halves.
+void mulhilo(__m128i a, __m128i m, __m128i &hi, __m128i &lo)
+{
+    auto even = _mm_mul_epu32(a, m);                     // lanes 0 and 2
+    auto odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), m); // lanes 1 and 3
+    lo = _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                            _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+    hi = _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 3, 1)),
+                            _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 3, 1)));
+}
+
+// Four consecutive blocks from `c` at once, one per lane, written out in
+// order as floats in [0, 1).
+void philox4_unit(std::array<std::uint32_t, 4> const &c,
+                  std::array<std::uint32_t, 2> k, float *out)
+{
+    auto c0 = _mm_add_epi32(_mm_set1_epi32(static_cast<int>(c[0])),
+                            _mm_setr_epi32(0, 1, 2, 3));
+    auto c1 = _mm_set1_epi32(static_cast<int>(c[1]));
+    auto c2 = _mm_set1_epi32(static_cast<int>(c[2]));
+    auto c3 = _mm_set1_epi32(static_cast<int>(c[3]));
+    auto const m0 = _mm_set1_epi32(static_cast<int>(philox_m0));
+    auto const m1 = _mm_set1_epi32(static_cast<int>(philox_m1));
+    for (int round{}; round != philox_rounds; ++round) {
+        __m128i hi0;
+        __m128i lo0;
+        __m128i hi1;
+        __m128i lo1;
+        mulhilo(c0, m0, hi0, lo0);
+        mulhilo(c2, m1, hi1, lo1);
+        auto k0 = _mm_set1_epi32(static_cast<int>(k[0]));
+        auto k1 = _mm_set1_epi32(static_cast<int>(k[1]));
+        c0 = _mm_xor_si128(_mm_xor_si128(hi1, c1), k0);
+        c1 = lo1;
+        c2 = _mm_xor_si128(_mm_xor_si128(hi0, c3), k1);
+        c3 = lo0;
+        k[0] += philox_w0;
+        k[1] += philox_w1;
+    }
+
+    auto const scale = _mm_set1_ps(word_to_unit);
+    auto to_unit = [&](__m128i words) {
+        return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(words, 8)), scale);
+    };
+    auto x0 = to_unit(c0);
+    auto x1 = to_unit(c1);
+    auto x2 = to_unit(c2);
+    auto x3 = to_unit(c3);
+    // Lanes are blocks; transpose so that each block's words are contiguous.
+    _MM_TRANSPOSE4_PS(x0, x1, x2, x3);
+    _mm_storeu_ps(out, x0);
+    _mm_storeu_ps(out + 4, x1);
+    _mm_storeu_ps(out + 8, x2);
+    _mm_storeu_ps(out + 12, x3);
+}
+#endif
+
+} // namespace
+
+Random_stream::Random_stream(std::uint64_t seed, Rng_domain domain,
+                             std::uint32_t id, std::uint64_t tick)
+    : counter_{0, id, static_cast<std::uint32_t>(tick),
+               static_cast<std::uint32_t>((tick >> 32U) & 0xFFFFU) |
+                   (static_cast<std::uint32_t>(domain) << 16U)},
+      key_{static_cast<std::uint32_t>(seed),
+           static_cast<std::uint32_t>(seed >> 32U)}
+{
+}
+
+Random_stream::result_type Random_stream::operator()()
+{
+    if (used_ == block_.size()) {
+        block_ = philox(counter_, key_);
+        ++counter_[0];
+        used_ = 0;
+    }
+    return block_[used_++];
+}
+
+float Random_stream::uniform()
+{
+    return static_cast<float>((*this)() >> 8U) * word_to_unit;
+}
+
+float Random_stream::uniform(float lo, float hi)
+{
+    return lo + (uniform() * (hi - lo));
+}
+
+int Random_stream::uniform_int(int lo, int hi)
+{
+    // Multiply-shift; the bias is below 2^-32 per value for game-sized ranges.
+    auto range = static_cast<std::uint64_t>(static_cast<std::int64_t>(hi) -
+                                            lo + 1);
+    return lo + static_cast<int>((range * (*this)()) >> 32U);
+}
+
+bool Random_stream::chance(float p)
+{
+    return uniform() < p;
+}
+
+void Random_stream::fill_uniform(std::span<float> out)
+{
+    used_ = block_.size();
+    std::size_t i{};
+#ifdef MB_SSE2
+    for (; i + 16 <= out.size(); i += 16) {
+        philox4_unit(counter_, key_, out.data() + i);
+        counter_[0] += 4;
+    }
+#endif
+    for (; i != out.size(); ++i) {
+        out[i] = uniform();
+    }
+    used_ = block_.size();
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <entt/entt.hpp>
+#include <span>
+
+// Keeps the numbers drawn for different purposes apart, even for the same id
+// and tick.
+enum class Rng_domain : std::uint16_t {
+    Terrain,
+    Spawn,
+    Ai,
+    Battle,
+    // Simulated battles, by run index. Forecasts made on the same tick share
+    // their numbers, which makes them directly comparable.
+    Forecast,
+};
+
+/// @brief Random numbers from Philox4x32-10, a counter-based generator.
+///
+/// Every number is a pure function of the world seed, the stream's domain, id
+/// and tick, and its position in the stream. A stream is a few words on the
+/// stack, so any system can open one per entity per tick on any thread and
+/// get the same numbers on every run, with nothing shared or locked.
+///
+/// Meets UniformRandomBitGenerator, for the standard distributions; note that
+/// those aren't guaranteed to give the same results across standard
+/// libraries, the members here are.
+class Random_stream {
+  public:
+    using result_type = std::uint32_t;
+
+    Random_stream(std::uint64_t seed, Rng_domain domain, std::uint32_t id,
+                  std::uint64_t tick);
+
+    static constexpr result_type min()
+    {
+        return 0;
+    }
+    static constexpr result_type max()
+    {
+        return ~result_type{};
+    }
+    result_type operator()();
+
+    // In [0, 1).
+    float uniform();
+    // In [lo, hi).
+    float uniform(float lo, float hi);
+    // In [lo, hi], both ends included.
+    int uniform_int(int lo, int hi);
+    bool chance(float p);
+
+    // Fills `out` with numbers in [0, 1), four blocks at a time. Starts at the
+    // next whole block: numbers left over from the current one are skipped.
+    void fill_uniform(std::span<float> out);
+
+  private:
+    std::array<std::uint32_t, 4> counter_;
+    std::array<std::uint32_t, 2> key_;
+    std::array<std::uint32_t, 4> block_{};
+    std::size_t used_{4}; // words of block_ handed out
+};
+
+// The world seed, from which every Random_stream is derived. Lives in the
+// registry's context.
+class Random {
+  public:
+    explicit Random(std::uint64_t seed) : seed_{seed} {}
+
+    [[nodiscard]] std::uint64_t seed() const
+    {
+        return seed_;
+    }
+
+    [[nodiscard]] Random_stream stream(Rng_domain domain, std::uint32_t id,
+                                       std::uint64_t tick) const
+    {
+        return {seed_, domain, id, tick};
+    }
+    [[nodiscard]] Random_stream stream(Rng_domain domain, entt::entity e,
+                                       std::uint64_t tick) const
+    {
+        return stream(domain, entt::to_integral(e), tick);
+    }
+
+  private:
+    std::uint64_t seed_;
+};
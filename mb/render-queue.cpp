@@ -0,0 +1,165 @@
+#include <mb/render-queue.h>
+
+#include <mb/check-gl-errors.h>
+
+#include <algorithm>
+#include <cassert>
+
+namespace {
+
+// Binding points of the storage blocks in main.vert.
+constexpr GLuint draw_data_binding{0};
+constexpr GLuint bones_binding{1};
+
+} // namespace
+
+Render_queue::Render_queue()
+{
+    glCreateBuffers(1, &draw_buffer_);
+    glCreateBuffers(1, &indirect_buffer_);
+    glCreateBuffers(1, &bone_buffer_);
+    check_gl_errors();
+}
+
+Render_queue::~Render_queue()
+{
+    glDeleteBuffers(1, &draw_buffer_);
+    glDeleteBuffers(1, &indirect_buffer_);
+    glDeleteBuffers(1, &bone_buffer_);
+}
+
+void Render_queue::submit(Shader_program const &shader, Mesh const &mesh,
+                          glm::mat4 const &model, glm::mat3 const &normal,
+                          std::span<glm::mat4 const> palette)
+{
+    auto const &range = mesh.range();
+    GLint bone_offset{-1};
+    if (range.layout.skinning != Skinning::None) {
+        assert(!palette.empty() && "Skinned mesh submitted without a palette");
+        if (palette.data() != last_palette_) {
+            last_palette_ = palette.data();
+            last_bone_offset_ = static_cast<GLint>(bones_.size());
+            bones_.insert(bones_.end(), palette.begin(), palette.end());
+        }
+        bone_offset = last_bone_offset_;
+    }
+    items_.push_back(Item{
+        .key = Bucket_key{.shader = &shader,
+                          .vao = mesh.vao(),
+                          .index_type = range.layout.index_type(),
+                          .diffuse = mesh.diffuse().texture(),
+                          .specular = mesh.specular().texture()},
+        .diffuse = mesh.diffuse(),
+        .specular = mesh.specular(),
+        .command = Draw_elements_indirect_command{.count = range.index_count,
+                                                  .instance_count = 1,
+                                                  .first_index =
+                                                      range.first_index,
+                                                  .base_vertex =
+                                                      range.base_vertex,
+                                                  .base_instance = 0},
+        .data = Draw_data{.model = model,
+                          .normal = glm::mat3x4(normal),
+                          .bone_offset = bone_offset}});
+}
+
+void Render_queue::flush(
+    std::function<void(Shader_program const &)> const &setup_shader)
+{
+    stats_ = {};
+    if (items_.empty()) {
+        return;
+    }
+
+    std::ranges::sort(items_, {}, &Item::key);
+
+    commands_.clear();
+    draws_.clear();
+    for (auto &item : items_) {
+        item.command.base_instance = static_cast<GLuint>(draws_.size());
+        commands_.push_back(item.command);
+        draws_.push_back(item.data);
+    }
+
+    // Orphan and refill: the driver hands out fresh storage while last
+    // frame's draws may still be in flight.
+    glNamedBufferData(
+        draw_buffer_,
+        static_cast<GLsizeiptr>(draws_.size() * sizeof(Draw_data)),
+        draws_.data(), GL_STREAM_DRAW);
+    glNamedBufferData(indirect_buffer_,
+                      static_cast<GLsizeiptr>(
+                          commands_.size() *
+                          sizeof(Draw_elements_indirect_command)),
+                      commands_.data(), GL_STREAM_DRAW);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, draw_data_binding,
+                     draw_buffer_);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect_buffer_);
+    if (!bones_.empty()) {
+        glNamedBufferData(
+            bone_buffer_,
+            static_cast<GLsizeiptr>(bones_.size() * sizeof(glm::mat4)),
+            bones_.data(), GL_STREAM_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, bones_binding,
+                         bone_buffer_);
+    }
+    check_gl_errors();
+
+    Shader_program const *current_shader{};
+    for (std::size_t first{}; first != items_.size();) {
+        auto const &key = items_[first].key;
+        auto last = first + 1;
+        while (last != items_.size() && items_[last].key == key) {
+            ++last;
+        }
+
+        if (key.shader != current_shader) {
+            current_shader = key.shader;
+            current_shader->use_program();
+            setup_shader(*current_shader);
+        }
+        bind_material(*key.shader, items_[first]);
+        glBindVertexArray(key.vao);
+        glMultiDrawElementsIndirect(
+            GL_TRIANGLES, key.index_type,
+            reinterpret_cast<void const *>(
+                first * sizeof(Draw_elements_indirect_command)),
+            static_cast<GLsizei>(last - first), 0);
+        check_gl_errors();
+
+        ++stats_.buckets;
+        first = last;
+    }
+    stats_.draws = items_.size();
+    stats_.bones = bones_.size();
+    spdlog::trace("Render queue: {} draws in {} buckets, {} bones",
+                  stats_.draws, stats_.buckets, stats_.bones);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    items_.clear();
+    bones_.clear();
+    last_palette_ = nullptr;
+}
+
+void Render_queue::bind_material(Shader_program const &shader,
+                                 Item const &item)
+{
+    if (!item.diffuse.is_null()) {
+        item.diffuse.bind_to_slot(0);
+        shader.uniform_1i("material.diffuse", 0);
+        shader.uniform_1i("material.num_diff", 1);
+    }
+    else {
+        shader.uniform_1i("material.num_diff", 0);
+    }
+    if (!item.specular.is_null()) {
+        item.specular.bind_to_slot(1);
+        shader.uniform_1i("material.specular", 1);
+        shader.uniform_1i("material.num_spec", 1);
+    }
+    else {
+        shader.uniform_1i("material.num_spec", 0);
+    }
+    shader.uniform_1f("material.shininess", 64);
+}
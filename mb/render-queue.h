@@ -0,0 +1,105 @@
+#pragma once
+#include <mb/mesh.h>
+#include <mb/shader-program.h>
+
+#include <array>
+#include <functional>
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include <span>
+#include <vector>
+
+// Layout mandated by glMultiDrawElementsIndirect.
+struct Draw_elements_indirect_command {
+    GLuint count;
+    GLuint instance_count;
+    GLuint first_index;
+    GLint base_vertex;
+    GLuint base_instance;
+};
+
+// std430 layout of `Draw` in main.vert. The normal matrix is a mat3 there,
+// whose columns are padded to vec4, and the struct is padded to a multiple of
+// 16 bytes.
+struct Draw_data {
+    glm::mat4 model;
+    glm::mat3x4 normal;
+    // First matrix of this draw's palette in the `Bones` buffer, or -1 for
+    // unskinned draws.
+    GLint bone_offset;
+    std::array<GLint, 3> padding{};
+};
+static_assert(sizeof(Draw_data) == 128);
+
+struct Render_stats {
+    std::size_t draws;
+    std::size_t buckets;
+    std::size_t bones;
+};
+
+/// @brief Collects the meshes to draw this frame and submits them in as few
+/// calls as possible.
+///
+/// Draws are bucketed by shader, vao (i.e. vertex layout) and textures. Each
+/// bucket becomes a single glMultiDrawElementsIndirect; per-draw matrices are
+/// fetched by the vertex shader from a storage buffer indexed by
+/// gl_BaseInstance. Skinning palettes go to a second storage buffer that is
+/// refilled every frame.
+class Render_queue {
+  public:
+    Render_queue();
+    Render_queue(Render_queue const &) = delete;
+    Render_queue(Render_queue &&) = delete;
+    Render_queue &operator=(Render_queue const &) = delete;
+    Render_queue &operator=(Render_queue &&) = delete;
+    ~Render_queue();
+
+    // `palette` is only read for skinned meshes. Consecutive submissions of
+    // the same palette (e.g. the meshes of one model) share one copy.
+    void submit(Shader_program const &shader, Mesh const &mesh,
+                glm::mat4 const &model, glm::mat3 const &normal,
+                std::span<glm::mat4 const> palette = {});
+
+    // Draws everything submitted since the last flush. `setup_shader` is
+    // called once per shader, after it is in use and before its first
+    // draw, to set per-frame uniforms.
+    void flush(
+        std::function<void(Shader_program const &)> const &setup_shader);
+
+    [[nodiscard]] Render_stats last_stats() const
+    {
+        return stats_;
+    }
+
+  private:
+    struct Bucket_key {
+        Shader_program const *shader;
+        GLuint vao;
+        GLenum index_type;
+        GLuint diffuse;
+        GLuint specular;
+
+        auto operator<=>(Bucket_key const &) const = default;
+    };
+
+    struct Item {
+        Bucket_key key;
+        Texture_view diffuse;
+        Texture_view specular;
+        Draw_elements_indirect_command command;
+        Draw_data data;
+    };
+
+    static void bind_material(Shader_program const &shader, Item const &item);
+
+    std::vector<Item> items_;
+    std::vector<Draw_elements_indirect_command> commands_;
+    std::vector<Draw_data> draws_;
+    std::vector<glm::mat4> bones_;
+    glm::mat4 const *last_palette_{};
+    GLint last_bone_offset_{-1};
+    GLuint draw_buffer_{};
+    GLuint indirect_buffer_{};
+    GLuint bone_buffer_{};
+    Render_stats stats_{};
+};
@@ -0,0 +1,288 @@
+#include <mb/resource-cache.h>
+
+#include <mb/model.h>
+
+#include <array>
+#include <fstream>
+#include <spdlog/spdlog.h>
+#include <vector>
+
+namespace {
+
+// FNV-1a, good enough to tell assets apart; not meant to be cryptographic.
+std::uint64_t fnv1a(std::span<unsigned char const> bytes,
+                    std::uint64_t hash = 14695981039346656037ULL)
+{
+    for (auto b : bytes) {
+        hash ^= b;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+std::uint64_t fnv1a(std::string_view s)
+{
+    return fnv1a({reinterpret_cast<unsigned char const *>(s.data()), s.size()});
+}
+
+// The same bytes decoded the other way up are a different texture.
+std::uint64_t encoded_key(std::span<unsigned char const> bytes,
+                          bool flip_vertically)
+{
+    unsigned char flip = flip_vertically ? 1 : 0;
+    return fnv1a(bytes, fnv1a({&flip, 1}));
+}
+
+std::vector<unsigned char> read_bytes(std::filesystem::path const &path)
+{
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs.is_open()) {
+        spdlog::error("Failed to open {}", path.string());
+        throw std::runtime_error("check last error");
+    }
+    return {std::istreambuf_iterator<char>(ifs),
+            std::istreambuf_iterator<char>()};
+}
+
+std::string canonical_key(std::filesystem::path const &path)
+{
+    std::error_code ec;
+    auto canonical = std::filesystem::canonical(path, ec);
+    if (ec) {
+        spdlog::error("Resource {} doesn't exist: {}", path.string(),
+                      ec.message());
+        throw std::runtime_error("check last error");
+    }
+    return canonical.string();
+}
+
+} // namespace
+
+Resource_cache::~Resource_cache()
+{
+    log_stats();
+}
+
+std::shared_ptr<Texture const>
+Resource_cache::load_texture(std::filesystem::path const &path)
+{
+    auto key = canonical_key(path);
+    if (auto it = keys_.find(key); it != keys_.end()) {
+        if (auto tex = textures_.find(it->second); tex != textures_.end()) {
+            ++hits_;
+            ++tex->second.hits;
+            return tex->second.resource;
+        }
+    }
+
+    auto bytes = read_bytes(key);
+    auto hash = encoded_key(bytes, true);
+    keys_[key] = hash;
+    if (auto tex = textures_.find(hash); tex != textures_.end()) {
+        spdlog::debug("Texture {} has the same content as a cached one", key);
+        ++hits_;
+        ++tex->second.hits;
+        return tex->second.resource;
+    }
+
+    ++misses_;
+    spdlog::info("Loading texture {}", key);
+    auto texture = std::make_shared<Texture const>(bytes, true);
+    textures_.insert({hash, Entry<Texture const>{.resource = texture,
+                                                 .bytes =
+                                                     texture->size_in_bytes(),
+                                                 .hits = 0}});
+    return texture;
+}
+
+std::shared_ptr<Texture const>
+Resource_cache::load_texture(std::span<unsigned char const> encoded,
+                             bool flip_vertically)
+{
+    auto hash = encoded_key(encoded, flip_vertically);
+    if (auto tex = textures_.find(hash); tex != textures_.end()) {
+        ++hits_;
+        ++tex->second.hits;
+        return tex->second.resource;
+    }
+
+    ++misses_;
+    auto texture = std::make_shared<Texture const>(encoded, flip_vertically);
+    textures_.insert({hash, Entry<Texture const>{.resource = texture,
+                                                 .bytes =
+                                                     texture->size_in_bytes(),
+                                                 .hits = 0}});
+    return texture;
+}
+
+std::shared_ptr<Texture const>
+Resource_cache::load_texture(int width, int height, int format,
+                             std::span<unsigned char const> pixels)
+{
+    // Same pixels in a different layout are a different texture.
+    std::array<int, 3> header{width, height, format};
+    auto hash = fnv1a(pixels, fnv1a({reinterpret_cast<unsigned char const *>(
+                                         header.data()),
+                                     sizeof(header)}));
+    if (auto tex = textures_.find(hash); tex != textures_.end()) {
+        ++hits_;
+        ++tex->second.hits;
+        return tex->second.resource;
+    }
+
+    ++misses_;
+    auto texture =
+        std::make_shared<Texture const>(width, height, format, pixels.data());
+    textures_.insert({hash, Entry<Texture const>{.resource = texture,
+                                                 .bytes =
+                                                     texture->size_in_bytes(),
+                                                 .hits = 0}});
+    return texture;
+}
+
+std::shared_ptr<Texture const> Resource_cache::default_texture()
+{
+    if (default_texture_ == nullptr) {
+        std::array<unsigned char, 4> default_grey{100, 100, 100, 255};
+        default_texture_ = load_texture(1, 1, GL_RGBA, default_grey);
+    }
+    return default_texture_;
+}
+
+std::shared_ptr<Model>
+Resource_cache::load_model(std::filesystem::path const &path)
+{
+    auto key = canonical_key(path);
+    if (auto it = keys_.find(key); it != keys_.end()) {
+        if (auto model = models_.find(it->second); model != models_.end()) {
+            ++hits_;
+            ++model->second.hits;
+            return model->second.resource;
+        }
+    }
+
+    auto hash = fnv1a(read_bytes(key));
+    keys_[key] = hash;
+    if (auto model = models_.find(hash); model != models_.end()) {
+        spdlog::debug("Model {} has the same content as a cached one", key);
+        ++hits_;
+        ++model->second.hits;
+        return model->second.resource;
+    }
+
+    ++misses_;
+    auto model = std::make_shared<Model>(*this, key);
+    models_.insert(
+        {hash, Entry<Model>{.resource = model, .bytes = 0, .hits = 0}});
+    return model;
+}
+
+std::shared_ptr<Model> Resource_cache::get_or_create_model(
+    std::string const &name,
+    std::function<std::shared_ptr<Model>()> const &make)
+{
+    auto key = "generated:" + name;
+    auto hash = fnv1a(key);
+    if (auto model = models_.find(hash); model != models_.end()) {
+        ++hits_;
+        ++model->second.hits;
+        return model->second.resource;
+    }
+
+    ++misses_;
+    auto model = make();
+    keys_[key] = hash;
+    models_.insert(
+        {hash, Entry<Model>{.resource = model, .bytes = 0, .hits = 0}});
+    return model;
+}
+
+std::string Resource_cache::key_of(Model const *model) const
+{
+    for (auto const &[key, hash] : keys_) {
+        if (auto it = models_.find(hash);
+            it != models_.end() && it->second.resource.get() == model) {
+            return key;
+        }
+    }
+    return {};
+}
+
+void Resource_cache::unload(std::filesystem::path const &path)
+{
+    auto key = path.string().starts_with("generated:") ? path.string()
+                                                       : canonical_key(path);
+    auto it = keys_.find(key);
+    if (it == keys_.end()) {
+        spdlog::warn("Unloading {} which isn't cached", key);
+        return;
+    }
+    auto hash = it->second;
+    std::erase_if(keys_, [hash](auto const &kv) { return kv.second == hash; });
+
+    auto warn_if_held = [&key](auto const &entry) {
+        if (entry.resource.use_count() > 1) {
+            spdlog::warn("Unloading {} while {} handle(s) are still alive", key,
+                         entry.resource.use_count() - 1);
+        }
+    };
+    if (auto tex = textures_.find(hash); tex != textures_.end()) {
+        warn_if_held(tex->second);
+        textures_.erase(tex);
+    }
+    if (auto model = models_.find(hash); model != models_.end()) {
+        warn_if_held(model->second);
+        models_.erase(model);
+    }
+}
+
+std::size_t Resource_cache::unload_unused()
+{
+    // Models go first, since they are what keep textures alive.
+    auto unused = [](auto const &kv) {
+        return kv.second.resource.use_count() == 1;
+    };
+    auto removed = std::erase_if(models_, unused);
+    removed += std::erase_if(textures_, [this](auto const &kv) {
+        return kv.second.resource.use_count() == 1 &&
+               kv.second.resource != default_texture_;
+    });
+    std::erase_if(keys_, [this](auto const &kv) {
+        return !textures_.contains(kv.second) && !models_.contains(kv.second);
+    });
+    spdlog::info("Unloaded {} unused resource(s)", removed);
+    return removed;
+}
+
+Resource_stats Resource_cache::stats() const
+{
+    Resource_stats stats{.hits = hits_,
+                         .misses = misses_,
+                         .textures = textures_.size(),
+                         .models = models_.size(),
+                         .texture_bytes = 0};
+    for (auto const &[hash, entry] : textures_) {
+        stats.texture_bytes += entry.bytes;
+    }
+    return stats;
+}
+
+void Resource_cache::log_stats() const
+{
+    auto s = stats();
+    spdlog::info("Resource cache: {} hit(s), {} miss(es), {} texture(s) ({} "
+                 "KiB), {} model(s)",
+                 s.hits, s.misses, s.textures, s.texture_bytes / 1024,
+                 s.models);
+    geometry_.log_stats();
+    for (auto const &[key, hash] : keys_) {
+        if (auto it = models_.find(hash); it != models_.end()) {
+            spdlog::debug("  model {}: {} hit(s), {} user(s)", key,
+                          it->second.hits, it->second.resource.use_count() - 1);
+        }
+        if (auto it = textures_.find(hash); it != textures_.end()) {
+            spdlog::debug("  texture {}: {} hit(s), {} user(s)", key,
+                          it->second.hits, it->second.resource.use_count() - 1);
+        }
+    }
+}
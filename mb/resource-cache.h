@@ -0,0 +1,99 @@
+#pragma once
+#include <mb/geometry-arena.h>
+#include <mb/texture.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <span>
+#include <string>
+#include <unordered_map>
+
+class Model;
+
+struct Resource_stats {
+    std::size_t hits;
+    std::size_t misses;
+    std::size_t textures;
+    std::size_t models;
+    std::size_t texture_bytes;
+};
+
+/// @brief Owns every texture and model loaded by the game, so that identical
+/// assets are paid for only once.
+///
+/// Lookups go by canonical path first, then by content hash: two paths that
+/// point at the same bytes (or an embedded texture that equals a file on disk)
+/// share one GPU resource. Handles are ref-counted; dropping an entry from the
+/// cache never invalidates handles that are still held.
+class Resource_cache {
+  public:
+    Resource_cache() = default;
+    Resource_cache(Resource_cache const &) = delete;
+    Resource_cache(Resource_cache &&) = delete;
+    Resource_cache &operator=(Resource_cache const &) = delete;
+    Resource_cache &operator=(Resource_cache &&) = delete;
+    ~Resource_cache();
+
+    std::shared_ptr<Texture const>
+    load_texture(std::filesystem::path const &path);
+
+    // Encoded image (png, jpg, ...) embedded in another asset; flipped like
+    // image files unless told otherwise.
+    std::shared_ptr<Texture const>
+    load_texture(std::span<unsigned char const> encoded,
+                 bool flip_vertically = true);
+
+    // Raw pixels embedded in another asset.
+    std::shared_ptr<Texture const>
+    load_texture(int width, int height, int format,
+                 std::span<unsigned char const> pixels);
+
+    // 1x1 grey texture for meshes without a material texture.
+    std::shared_ptr<Texture const> default_texture();
+
+    std::shared_ptr<Model> load_model(std::filesystem::path const &path);
+
+    // Procedurally generated models have no file, so they are keyed by name.
+    std::shared_ptr<Model>
+    get_or_create_model(std::string const &name,
+                        std::function<std::shared_ptr<Model>()> const &make);
+
+    // Reverse lookup of the path or name a model was loaded with. Returns an
+    // empty string for models this cache doesn't know.
+    [[nodiscard]] std::string key_of(Model const *model) const;
+
+    // Forgets the resource loaded from `path`. Handles still held elsewhere
+    // stay valid until released.
+    void unload(std::filesystem::path const &path);
+
+    // Drops every resource referenced by nobody but the cache.
+    std::size_t unload_unused();
+
+    // Vertex and index storage shared by every mesh of every model.
+    Geometry_arena &geometry()
+    {
+        return geometry_;
+    }
+
+    [[nodiscard]] Resource_stats stats() const;
+    void log_stats() const;
+
+  private:
+    template <typename T> struct Entry {
+        std::shared_ptr<T> resource;
+        std::size_t bytes;
+        std::size_t hits;
+    };
+
+    // Declared first so that it outlives every cached model's meshes.
+    Geometry_arena geometry_;
+    // Canonical path (or generated name) -> content hash.
+    std::unordered_map<std::string, std::uint64_t> keys_;
+    std::unordered_map<std::uint64_t, Entry<Texture const>> textures_;
+    std::unordered_map<std::uint64_t, Entry<Model>> models_;
+    std::shared_ptr<Texture const> default_texture_;
+    std::size_t hits_{};
+    std::size_t misses_{};
+};
@@ -0,0 +1,8 @@
+#pragma once
+
+// MB_SSE2 is defined where the SSE2 intrinsics can be used. SSE2 is part of
+// the x86-64 baseline, so this needs no extra build flags.
+#if defined(__SSE2__) || defined(_M_X64)
+#define MB_SSE2
+#include <immintrin.h>
+#endif
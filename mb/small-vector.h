@@ -0,0 +1,276 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+
+struct Small_vector_stats {
+    std::size_t allocations; // heap blocks, the first when a vector spills
+    std::size_t largest;     // most elements one vector has held
+};
+
+/// @brief Vector that keeps up to N elements inside itself.
+///
+/// Components hold their usual few elements inline, next to the rest of the
+/// component, so iterating them touches no other memory and making them
+/// allocates nothing. Past N the elements move to the heap like a
+/// std::vector's. Statistics are kept per instantiation, so give each kind
+/// of list its own alias and check its stats before changing its N.
+///
+/// Only for trivially copyable elements, which is all components hold.
+template <typename T, std::size_t N>
+class Small_vector {
+    static_assert(std::is_trivially_copyable_v<T>);
+    static_assert(N > 0);
+
+  public:
+    using value_type = T;
+    using size_type = std::size_t;
+    using iterator = T *;
+    using const_iterator = T const *;
+
+    Small_vector() = default;
+    Small_vector(std::initializer_list<T> init)
+    {
+        assign(init.begin(), init.end());
+    }
+    template <std::input_iterator It>
+    Small_vector(It first, It last)
+    {
+        assign(first, last);
+    }
+    Small_vector(Small_vector const &other)
+    {
+        assign(other.begin(), other.end());
+    }
+    Small_vector(Small_vector &&other) noexcept
+    {
+        steal(other);
+    }
+    Small_vector &operator=(Small_vector const &other)
+    {
+        if (this != &other) {
+            assign(other.begin(), other.end());
+        }
+        return *this;
+    }
+    Small_vector &operator=(Small_vector &&other) noexcept
+    {
+        if (this != &other) {
+            release();
+            steal(other);
+        }
+        return *this;
+    }
+    ~Small_vector()
+    {
+        release();
+    }
+
+    template <std::input_iterator It>
+    void assign(It first, It last)
+    {
+        clear();
+        if constexpr (std::forward_iterator<It>) {
+            reserve(static_cast<std::size_t>(std::distance(first, last)));
+        }
+        for (; first != last; ++first) {
+            push_back(*first);
+        }
+    }
+
+    void push_back(T const &value)
+    {
+        emplace_back(value);
+    }
+    template <typename... Args>
+    T &emplace_back(Args &&...args)
+    {
+        // The arguments may refer into this vector; build before growing.
+        T value{std::forward<Args>(args)...};
+        if (size_ == capacity_) {
+            grow(capacity_ * 2);
+        }
+        data_[size_++] = value;
+        note_size();
+        return back();
+    }
+    void pop_back()
+    {
+        --size_;
+    }
+    // Keeps the capacity.
+    void clear()
+    {
+        size_ = 0;
+    }
+    void reserve(std::size_t capacity)
+    {
+        if (capacity > capacity_) {
+            grow(capacity);
+        }
+    }
+    void resize(std::size_t size)
+    {
+        reserve(size);
+        std::fill(data_ + size_, data_ + std::max(size, size_), T{});
+        size_ = size;
+        note_size();
+    }
+    iterator erase(const_iterator first, const_iterator last)
+    {
+        auto *at = data_ + (first - data_);
+        auto *tail = std::copy(data_ + (last - data_), end(), at);
+        size_ = static_cast<std::size_t>(tail - data_);
+        return at;
+    }
+    iterator erase(const_iterator pos)
+    {
+        return erase(pos, pos + 1);
+    }
+
+    [[nodiscard]] T *data()
+    {
+        return data_;
+    }
+    [[nodiscard]] T const *data() const
+    {
+        return data_;
+    }
+    [[nodiscard]] iterator begin()
+    {
+        return data_;
+    }
+    [[nodiscard]] iterator end()
+    {
+        return data_ + size_;
+    }
+    [[nodiscard]] const_iterator begin() const
+    {
+        return data_;
+    }
+    [[nodiscard]] const_iterator end() const
+    {
+        return data_ + size_;
+    }
+    [[nodiscard]] T &operator[](std::size_t i)
+    {
+        return data_[i];
+    }
+    [[nodiscard]] T const &operator[](std::size_t i) const
+    {
+        return data_[i];
+    }
+    [[nodiscard]] T &front()
+    {
+        return data_[0];
+    }
+    [[nodiscard]] T const &front() const
+    {
+        return data_[0];
+    }
+    [[nodiscard]] T &back()
+    {
+        return data_[size_ - 1];
+    }
+    [[nodiscard]] T const &back() const
+    {
+        return data_[size_ - 1];
+    }
+    [[nodiscard]] std::size_t size() const
+    {
+        return size_;
+    }
+    [[nodiscard]] std::size_t capacity() const
+    {
+        return capacity_;
+    }
+    [[nodiscard]] bool empty() const
+    {
+        return size_ == 0;
+    }
+    // Whether the elements are still inside the vector.
+    [[nodiscard]] bool is_inline() const
+    {
+        return data_ == inline_data();
+    }
+
+    friend bool operator==(Small_vector const &a, Small_vector const &b)
+    {
+        return std::ranges::equal(a, b);
+    }
+
+    [[nodiscard]] static Small_vector_stats stats()
+    {
+        return {.allocations = allocations_.load(std::memory_order_relaxed),
+                .largest = largest_.load(std::memory_order_relaxed)};
+    }
+
+  private:
+    [[nodiscard]] T *inline_data()
+    {
+        return reinterpret_cast<T *>(storage_);
+    }
+    [[nodiscard]] T const *inline_data() const
+    {
+        return reinterpret_cast<T const *>(storage_);
+    }
+
+    void grow(std::size_t capacity)
+    {
+        allocations_.fetch_add(1, std::memory_order_relaxed);
+        auto *heap = std::allocator<T>{}.allocate(capacity);
+        std::copy(begin(), end(), heap);
+        release();
+        data_ = heap;
+        capacity_ = capacity;
+    }
+
+    // Frees the heap block, if any; leaves the elements dangling.
+    void release()
+    {
+        if (!is_inline()) {
+            std::allocator<T>{}.deallocate(data_, capacity_);
+        }
+    }
+
+    // Takes `other`'s heap block, or copies its inline elements, and leaves
+    // it empty and inline.
+    void steal(Small_vector &other)
+    {
+        if (other.is_inline()) {
+            data_ = inline_data();
+            capacity_ = N;
+            std::copy(other.begin(), other.end(), data_);
+        }
+        else {
+            data_ = other.data_;
+            capacity_ = other.capacity_;
+        }
+        size_ = other.size_;
+        other.data_ = other.inline_data();
+        other.capacity_ = N;
+        other.size_ = 0;
+    }
+
+    void note_size() const
+    {
+        auto largest = largest_.load(std::memory_order_relaxed);
+        while (size_ > largest &&
+               !largest_.compare_exchange_weak(largest, size_,
+                                               std::memory_order_relaxed)) {
+        }
+    }
+
+    // Relaxed: only read for reports.
+    inline static std::atomic<std::size_t> allocations_{};
+    inline static std::atomic<std::size_t> largest_{};
+
+    T *data_{inline_data()};
+    std::size_t size_{};
+    std::size_t capacity_{N};
+    alignas(T) std::byte storage_[sizeof(T) * N];
+};
@@ -0,0 +1,454 @@
+#include <mb/snapshot.h>
+
+#include <mb/thread-pool.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <fstream>
+#include <numeric>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+#include <zlib.h>
+
+namespace {
+
+constexpr std::array<char, 4> snapshot_magic{'M', 'B', 'S', 'V'};
+constexpr std::uint32_t snapshot_version{1};
+
+enum class Snapshot_kind : std::uint32_t { Full, Incremental };
+
+// Written uncompressed in front of the zlib stream.
+struct Snapshot_header {
+    std::array<char, 4> magic;
+    std::uint32_t version;
+    Snapshot_kind kind;
+    std::uint32_t reserved;
+    std::uint64_t tick;
+    std::uint64_t base_tick; // incremental only
+    std::uint64_t payload_size;
+};
+
+[[noreturn]] void corrupt(std::string_view what)
+{
+    spdlog::error("Snapshot: {}", what);
+    throw std::runtime_error("check last error");
+}
+
+void write_entities(Snapshot_writer &out,
+                    std::span<entt::entity const> entities)
+{
+    out.varint(entities.size());
+    for (auto e : entities) {
+        out.entity(e);
+    }
+}
+
+std::vector<entt::entity> read_entities(Snapshot_reader &in)
+{
+    std::vector<entt::entity> entities(in.varint());
+    for (auto &e : entities) {
+        e = in.entity();
+    }
+    return entities;
+}
+
+std::unordered_map<entt::entity, std::size_t>
+index_of(std::span<entt::entity const> entities)
+{
+    std::unordered_map<entt::entity, std::size_t> index;
+    index.reserve(entities.size());
+    for (std::size_t i{}; i != entities.size(); ++i) {
+        index.emplace(entities[i], i);
+    }
+    return index;
+}
+
+// Writes the changes to one pool since `base`, or all of it.
+void write_pool(Snapshot_writer &out, Pool_image const &pool,
+                Pool_image const *base,
+                std::unordered_set<entt::entity> const &alive)
+{
+    std::vector<entt::entity> removed;
+    std::vector<std::size_t> upserted;
+    if (base == nullptr) {
+        upserted.resize(pool.entities.size());
+        std::iota(upserted.begin(), upserted.end(), std::size_t{});
+    }
+    else {
+        auto before = index_of(base->entities);
+        for (std::size_t i{}; i != pool.entities.size(); ++i) {
+            auto it = before.find(pool.entities[i]);
+            if (it == before.end() ||
+                !std::ranges::equal(pool.record(i),
+                                    base->record(it->second))) {
+                upserted.push_back(i);
+            }
+            if (it != before.end()) {
+                before.erase(it);
+            }
+        }
+        // Destroyed entities lose their components anyway.
+        for (auto [e, i] : before) {
+            if (alive.contains(e)) {
+                removed.push_back(e);
+            }
+        }
+    }
+
+    write_entities(out, removed);
+    out.varint(upserted.size());
+    for (auto i : upserted) {
+        out.entity(pool.entities[i]);
+    }
+    // Fixed-size records go as one block, others each with their size.
+    for (auto i : upserted) {
+        auto record = pool.record(i);
+        if (pool.record_size == Pool_image::varying) {
+            out.varint(record.size());
+        }
+        out.bytes(record);
+    }
+}
+
+void skip_pool(Snapshot_reader &in, std::size_t record_size,
+               std::size_t records)
+{
+    if (record_size != Pool_image::varying) {
+        in.bytes(record_size * records);
+        return;
+    }
+    for (std::size_t i{}; i != records; ++i) {
+        in.bytes(in.varint());
+    }
+}
+
+} // namespace
+
+void Snapshot_writer::varint(std::uint64_t value)
+{
+    while (value >= 0x80) {
+        buffer_.push_back(static_cast<std::byte>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    buffer_.push_back(static_cast<std::byte>(value));
+}
+
+void Snapshot_writer::string(std::string_view s)
+{
+    varint(s.size());
+    bytes(std::as_bytes(std::span{s}));
+}
+
+std::uint64_t Snapshot_reader::varint()
+{
+    std::uint64_t value{};
+    for (int shift{}; shift < 64; shift += 7) {
+        auto byte = std::to_integer<std::uint64_t>(bytes(1)[0]);
+        value |= (byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+    corrupt("varint too long");
+}
+
+std::string Snapshot_reader::string()
+{
+    auto chars = bytes(varint());
+    return {reinterpret_cast<char const *>(chars.data()), chars.size()};
+}
+
+std::span<std::byte const> Snapshot_reader::bytes(std::size_t size)
+{
+    if (size > data_.size()) {
+        corrupt("truncated");
+    }
+    auto result = data_.first(size);
+    data_ = data_.subspan(size);
+    return result;
+}
+
+std::span<std::byte const> Pool_image::record(std::size_t i) const
+{
+    if (record_size != varying) {
+        return std::span{records}.subspan(i * record_size, record_size);
+    }
+    auto begin = i == 0 ? 0 : ends[i - 1];
+    return std::span{records}.subspan(begin, ends[i] - begin);
+}
+
+World_image Snapshot_schema::capture(entt::registry &registry,
+                                     std::uint64_t tick) const
+{
+    World_image image{.tick = tick, .entities{}, .pools{}, .context{}};
+    auto &entities = registry.storage<entt::entity>();
+    image.entities.reserve(entities.size());
+    for (auto [e] : entities.each()) {
+        image.entities.push_back(e);
+    }
+    image.pools.resize(pools_.size());
+    for (std::size_t i{}; i != pools_.size(); ++i) {
+        pools_[i]->capture(registry, image.pools[i]);
+    }
+    for (auto const &var : contexts_) {
+        image.context.push_back(var->capture(registry));
+    }
+    return image;
+}
+
+std::vector<std::byte> Snapshot_schema::encode(World_image const &image,
+                                               World_image const *base) const
+{
+    Snapshot_writer out;
+
+    // Entities: destroyed since the base, then created since it.
+    std::unordered_set<entt::entity> alive{image.entities.begin(),
+                                           image.entities.end()};
+    if (base == nullptr) {
+        write_entities(out, {});
+        write_entities(out, image.entities);
+    }
+    else {
+        std::unordered_set<entt::entity> before{base->entities.begin(),
+                                                base->entities.end()};
+        std::vector<entt::entity> destroyed;
+        std::vector<entt::entity> created;
+        std::ranges::copy_if(base->entities, std::back_inserter(destroyed),
+                             [&](auto e) { return !alive.contains(e); });
+        std::ranges::copy_if(image.entities, std::back_inserter(created),
+                             [&](auto e) { return !before.contains(e); });
+        write_entities(out, destroyed);
+        write_entities(out, created);
+    }
+
+    out.varint(pools_.size());
+    for (std::size_t i{}; i != pools_.size(); ++i) {
+        out.string(pools_[i]->name);
+        out.varint(pools_[i]->record_size);
+        write_pool(out, image.pools[i],
+                   base == nullptr ? nullptr : &base->pools[i], alive);
+    }
+
+    out.varint(contexts_.size());
+    for (std::size_t i{}; i != contexts_.size(); ++i) {
+        out.string(contexts_[i]->name);
+        out.varint(image.context[i].size());
+        out.bytes(image.context[i]);
+    }
+
+    auto const &payload = out.buffer();
+    Snapshot_header header{
+        .magic = snapshot_magic,
+        .version = snapshot_version,
+        .kind = base == nullptr ? Snapshot_kind::Full
+                                : Snapshot_kind::Incremental,
+        .reserved = 0,
+        .tick = image.tick,
+        .base_tick = base == nullptr ? 0 : base->tick,
+        .payload_size = payload.size()};
+    auto packed_size = compressBound(payload.size());
+    std::vector<std::byte> file(sizeof(header) + packed_size);
+    std::memcpy(file.data(), &header, sizeof(header));
+    if (compress2(reinterpret_cast<Bytef *>(file.data() + sizeof(header)),
+                  &packed_size,
+                  reinterpret_cast<Bytef const *>(payload.data()),
+                  payload.size(), Z_DEFAULT_COMPRESSION) != Z_OK) {
+        corrupt("unable to compress");
+    }
+    file.resize(sizeof(header) + packed_size);
+    return file;
+}
+
+void Snapshot_schema::load(entt::registry &registry,
+                           std::filesystem::path const &path) const
+{
+    std::ifstream file{path, std::ios::binary | std::ios::ate};
+    if (!file) {
+        spdlog::error("Unable to open snapshot {}", path.string());
+        throw std::runtime_error("check last error");
+    }
+    std::vector<std::byte> bytes(static_cast<std::size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(reinterpret_cast<char *>(bytes.data()),
+              static_cast<std::streamsize>(bytes.size()));
+
+    Snapshot_header header{};
+    if (!file || bytes.size() < sizeof(header)) {
+        corrupt("truncated header");
+    }
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if (header.magic != snapshot_magic ||
+        header.version != snapshot_version) {
+        corrupt("wrong format or version");
+    }
+    std::vector<std::byte> payload(header.payload_size);
+    auto payload_size = static_cast<uLongf>(payload.size());
+    if (uncompress(reinterpret_cast<Bytef *>(payload.data()), &payload_size,
+                   reinterpret_cast<Bytef const *>(bytes.data() +
+                                                   sizeof(header)),
+                   bytes.size() - sizeof(header)) != Z_OK ||
+        payload_size != payload.size()) {
+        corrupt("unable to decompress");
+    }
+
+    Snapshot_reader in{payload};
+    if (header.kind == Snapshot_kind::Full) {
+        registry.clear();
+    }
+    for (auto e : read_entities(in)) {
+        if (registry.valid(e)) {
+            registry.destroy(e);
+        }
+    }
+    for (auto e : read_entities(in)) {
+        if (registry.create(e) != e) {
+            corrupt("entity already in use");
+        }
+    }
+
+    for (auto pools = in.varint(); pools != 0; --pools) {
+        auto name = in.string();
+        auto record_size = in.varint();
+        auto removed = read_entities(in);
+        auto upserted = read_entities(in);
+        auto it = std::ranges::find(pools_, name, [](auto const &pool) {
+            return std::string_view{pool->name};
+        });
+        if (it == pools_.end() || (*it)->record_size != record_size) {
+            spdlog::warn("Snapshot: skipping unknown component {}", name);
+            skip_pool(in, record_size, upserted.size());
+            continue;
+        }
+        (*it)->remove(registry, removed);
+        (*it)->restore(registry, upserted, in);
+    }
+
+    for (auto vars = in.varint(); vars != 0; --vars) {
+        auto name = in.string();
+        auto value = in.bytes(in.varint());
+        auto it = std::ranges::find(contexts_, name, [](auto const &var) {
+            return std::string_view{var->name};
+        });
+        if (it != contexts_.end()) {
+            (*it)->restore(registry, value);
+        }
+    }
+    if (!in.at_end()) {
+        corrupt("trailing bytes");
+    }
+    spdlog::info("Loaded snapshot {} of tick {}", path.string(), header.tick);
+}
+
+Snapshot_saver::Snapshot_saver(Snapshot_schema schema,
+                               std::filesystem::path directory,
+                               Thread_pool &pool)
+    : schema_{std::move(schema)}, directory_{std::move(directory)},
+      pool_{&pool}
+{
+    std::filesystem::create_directories(directory_);
+}
+
+Snapshot_saver::~Snapshot_saver()
+{
+    // A save captures `this`.
+    if (saving_.valid()) {
+        saving_.wait();
+    }
+}
+
+bool Snapshot_saver::save(entt::registry &registry, std::uint64_t tick)
+{
+    using namespace std::chrono;
+    if (saving_.valid()) {
+        if (saving_.wait_for(seconds{0}) != std::future_status::ready) {
+            return false;
+        }
+        saving_.get();
+    }
+
+    auto start = steady_clock::now();
+    auto image =
+        std::make_shared<World_image const>(schema_.capture(registry, tick));
+    auto full = saves_++ % full_every == 0;
+    spdlog::debug("Snapshot of tick {} captured in {:.3f}ms", tick,
+                  duration<double, std::milli>(steady_clock::now() - start)
+                      .count());
+
+    saving_ = pool_->submit([this, image = std::move(image), full] {
+        try {
+            auto start = steady_clock::now();
+            auto const *base = full ? nullptr : base_.get();
+            auto bytes = schema_.encode(*image, base);
+            auto path =
+                directory_ / fmt::format("{}-{:010}.mbsave",
+                                         base == nullptr ? "full" : "incr",
+                                         image->tick);
+            std::ofstream out{path, std::ios::binary | std::ios::trunc};
+            out.write(reinterpret_cast<char const *>(bytes.data()),
+                      static_cast<std::streamsize>(bytes.size()));
+            if (!out) {
+                spdlog::error("Unable to write snapshot {}", path.string());
+                return;
+            }
+            if (base == nullptr) {
+                base_ = image;
+            }
+            spdlog::info(
+                "Saved {} ({} bytes) in {:.1f}ms", path.string(), bytes.size(),
+                duration<double, std::milli>(steady_clock::now() - start)
+                    .count());
+        }
+        catch (std::exception const &e) {
+            spdlog::error("Snapshot save failed: {}", e.what());
+        }
+    });
+    return true;
+}
+
+bool Snapshot_saver::load_latest(entt::registry &registry,
+                                 std::function<void()> const &reset)
+{
+    if (saving_.valid()) {
+        saving_.get();
+    }
+
+    // Ticks are zero-padded, so names sort by tick.
+    std::string full;
+    std::vector<std::string> incrementals;
+    for (auto const &entry : std::filesystem::directory_iterator{directory_}) {
+        auto name = entry.path().filename().string();
+        if (entry.path().extension() != ".mbsave") {
+            continue;
+        }
+        if (name.starts_with("full-")) {
+            full = std::max(full, name);
+        }
+        else if (name.starts_with("incr-")) {
+            incrementals.push_back(std::move(name));
+        }
+    }
+    if (full.empty()) {
+        spdlog::warn("No snapshot to load in {}", directory_.string());
+        return false;
+    }
+    // Only those taken after the full one are against it.
+    std::string incremental;
+    for (auto &name : incrementals) {
+        if (name.substr(5) > full.substr(5)) {
+            incremental = std::max(incremental, name);
+        }
+    }
+
+    reset();
+    schema_.load(registry, directory_ / full);
+    if (!incremental.empty()) {
+        schema_.load(registry, directory_ / incremental);
+    }
+    spdlog::info("Loaded {}{}{}", full, incremental.empty() ? "" : " + ",
+                 incremental);
+    saves_ = 0;
+    return true;
+}
@@ -0,0 +1,381 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <entt/entt.hpp>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+class Thread_pool;
+
+// Appends the fields of a snapshot record.
+class Snapshot_writer {
+  public:
+    // LEB128: seven bits per byte, so small numbers take one byte.
+    void varint(std::uint64_t value);
+    void entity(entt::entity e)
+    {
+        varint(entt::to_integral(e));
+    }
+    void string(std::string_view s);
+    void bytes(std::span<std::byte const> data)
+    {
+        buffer_.insert(buffer_.end(), data.begin(), data.end());
+    }
+    template <typename T>
+        requires std::is_trivially_copyable_v<T>
+    void raw(T const &value)
+    {
+        bytes(std::as_bytes(std::span{&value, 1}));
+    }
+
+    [[nodiscard]] std::vector<std::byte> &buffer()
+    {
+        return buffer_;
+    }
+
+  private:
+    std::vector<std::byte> buffer_;
+};
+
+// Reads back what a Snapshot_writer wrote. Throws on reading past the end.
+class Snapshot_reader {
+  public:
+    explicit Snapshot_reader(std::span<std::byte const> data) : data_{data} {}
+
+    std::uint64_t varint();
+    entt::entity entity()
+    {
+        return static_cast<entt::entity>(varint());
+    }
+    std::string string();
+    std::span<std::byte const> bytes(std::size_t size);
+    template <typename T>
+        requires std::is_trivially_copyable_v<T>
+    T raw()
+    {
+        T value;
+        std::memcpy(&value, bytes(sizeof(T)).data(), sizeof(T));
+        return value;
+    }
+
+    [[nodiscard]] bool at_end() const
+    {
+        return data_.empty();
+    }
+
+  private:
+    std::span<std::byte const> data_;
+};
+
+// One component pool as captured: the entities that have the component and
+// one encoded record each.
+struct Pool_image {
+    // Record size of pools whose records vary in size.
+    static constexpr std::size_t varying{~std::size_t{}};
+
+    std::vector<entt::entity> entities;
+    std::vector<std::byte> records;
+    std::size_t record_size;       // in bytes, or varying
+    std::vector<std::size_t> ends; // if varying, record i ends at ends[i]
+
+    [[nodiscard]] std::span<std::byte const> record(std::size_t i) const;
+};
+
+// Everything a snapshot saves, as of one tick.
+struct World_image {
+    std::uint64_t tick;
+    std::vector<entt::entity> entities; // alive
+    std::vector<Pool_image> pools;      // in schema order
+    std::vector<std::vector<std::byte>> context;
+};
+
+/// @brief Which components and context variables snapshots save, and how.
+///
+/// Trivially copyable components are captured by copying their values into
+/// one flat block and written as is. Others are given an encoder, run at
+/// capture, and a decoder. Entity ids are written as varints and keep their
+/// versions, so components that refer to entities stay valid on load.
+///
+/// A full snapshot holds the whole world; an incremental one holds what
+/// changed since a base: created and destroyed entities, and per pool the
+/// entities that lost the component and the records that are new or differ.
+/// Pools and context variables are matched by name on load, so adding one
+/// keeps old snapshots loadable.
+class Snapshot_schema {
+  public:
+    // Records are the bytes of T, saved and compared as they are, so T
+    // must have no padding; padded types need an encoder.
+    template <typename T>
+        requires std::is_trivially_copyable_v<T>
+    Snapshot_schema &component(std::string name)
+    {
+        pools_.push_back(std::make_unique<Raw_pool<T>>(std::move(name)));
+        return *this;
+    }
+
+    template <typename T>
+    Snapshot_schema &
+    component(std::string name,
+              std::function<void(Snapshot_writer &, T const &)> encode,
+              std::function<T(Snapshot_reader &)> decode)
+    {
+        pools_.push_back(std::make_unique<Encoded_pool<T>>(
+            std::move(name), std::move(encode), std::move(decode)));
+        return *this;
+    }
+
+    // A variable of the registry's context.
+    template <typename T>
+        requires std::is_trivially_copyable_v<T>
+    Snapshot_schema &context(std::string name)
+    {
+        contexts_.push_back(std::make_unique<Context<T>>(std::move(name)));
+        return *this;
+    }
+
+    // Copies what is saved out of `registry`. Tick thread.
+    [[nodiscard]] World_image capture(entt::registry &registry,
+                                      std::uint64_t tick) const;
+
+    // Compressed snapshot file of `image`: full without a base, else with
+    // the changes since `base`. Touches no registry, so may run on any
+    // thread.
+    [[nodiscard]] std::vector<std::byte>
+    encode(World_image const &image, World_image const *base) const;
+
+    // Applies the snapshot file at `path`. A full one replaces the world; an
+    // incremental one must be applied on top of the full one it was taken
+    // against.
+    void load(entt::registry &registry,
+              std::filesystem::path const &path) const;
+
+  private:
+    struct Pool {
+        explicit Pool(std::string name, std::size_t record_size)
+            : name{std::move(name)}, record_size{record_size}
+        {
+        }
+        Pool(Pool const &) = delete;
+        Pool(Pool &&) = delete;
+        Pool &operator=(Pool const &) = delete;
+        Pool &operator=(Pool &&) = delete;
+        virtual ~Pool() = default;
+
+        virtual void capture(entt::registry &registry,
+                             Pool_image &image) const = 0;
+        virtual void remove(entt::registry &registry,
+                            std::span<entt::entity const> entities) const = 0;
+        // Gives `entities` the components read from `records`, replacing
+        // what they had.
+        virtual void restore(entt::registry &registry,
+                             std::span<entt::entity const> entities,
+                             Snapshot_reader &records) const = 0;
+
+        std::string name;
+        std::size_t record_size; // or Pool_image::varying
+    };
+
+    template <typename T>
+    struct Raw_pool final : Pool {
+        explicit Raw_pool(std::string name)
+            : Pool{std::move(name), std::is_empty_v<T> ? 0 : sizeof(T)}
+        {
+        }
+
+        void capture(entt::registry &registry,
+                     Pool_image &image) const override
+        {
+            auto &storage = registry.storage<T>();
+            image.entities.reserve(storage.size());
+            image.record_size = record_size;
+            if constexpr (std::is_empty_v<T>) {
+                for (auto [e] : storage.each()) {
+                    image.entities.push_back(e);
+                }
+            }
+            else {
+                image.records.resize(storage.size() * sizeof(T));
+                auto *out = image.records.data();
+                for (auto [e, value] : storage.each()) {
+                    image.entities.push_back(e);
+                    std::memcpy(out, &value, sizeof(T));
+                    out += sizeof(T);
+                }
+            }
+        }
+
+        void remove(entt::registry &registry,
+                    std::span<entt::entity const> entities) const override
+        {
+            registry.storage<T>().remove(entities.begin(), entities.end());
+        }
+
+        void restore(entt::registry &registry,
+                     std::span<entt::entity const> entities,
+                     Snapshot_reader &records) const override
+        {
+            remove(registry, entities);
+            if constexpr (std::is_empty_v<T>) {
+                registry.insert<T>(entities.begin(), entities.end());
+            }
+            else {
+                auto block = records.bytes(entities.size() * sizeof(T));
+                std::vector<T> values(entities.size());
+                std::memcpy(values.data(), block.data(), block.size());
+                registry.insert<T>(entities.begin(), entities.end(),
+                                   values.begin());
+            }
+        }
+    };
+
+    template <typename T>
+    struct Encoded_pool final : Pool {
+        Encoded_pool(std::string name,
+                     std::function<void(Snapshot_writer &, T const &)> encode,
+                     std::function<T(Snapshot_reader &)> decode)
+            : Pool{std::move(name), Pool_image::varying},
+              encode{std::move(encode)},
+              decode{std::move(decode)}
+        {
+        }
+
+        void capture(entt::registry &registry,
+                     Pool_image &image) const override
+        {
+            auto &storage = registry.storage<T>();
+            image.entities.reserve(storage.size());
+            image.ends.reserve(storage.size());
+            image.record_size = record_size;
+            Snapshot_writer out;
+            for (auto [e, value] : storage.each()) {
+                image.entities.push_back(e);
+                encode(out, value);
+                image.ends.push_back(out.buffer().size());
+            }
+            image.records = std::move(out.buffer());
+        }
+
+        void remove(entt::registry &registry,
+                    std::span<entt::entity const> entities) const override
+        {
+            registry.storage<T>().remove(entities.begin(), entities.end());
+        }
+
+        void restore(entt::registry &registry,
+                     std::span<entt::entity const> entities,
+                     Snapshot_reader &records) const override
+        {
+            for (auto e : entities) {
+                Snapshot_reader record{records.bytes(records.varint())};
+                registry.emplace_or_replace<T>(e, decode(record));
+            }
+        }
+
+        std::function<void(Snapshot_writer &, T const &)> encode;
+        std::function<T(Snapshot_reader &)> decode;
+    };
+
+    struct Context_var {
+        explicit Context_var(std::string name) : name{std::move(name)} {}
+        Context_var(Context_var const &) = delete;
+        Context_var(Context_var &&) = delete;
+        Context_var &operator=(Context_var const &) = delete;
+        Context_var &operator=(Context_var &&) = delete;
+        virtual ~Context_var() = default;
+
+        // Empty if the registry has no such variable.
+        [[nodiscard]] virtual std::vector<std::byte>
+        capture(entt::registry &registry) const = 0;
+        virtual void restore(entt::registry &registry,
+                             std::span<std::byte const> value) const = 0;
+
+        std::string name;
+    };
+
+    template <typename T>
+    struct Context final : Context_var {
+        using Context_var::Context_var;
+
+        [[nodiscard]] std::vector<std::byte>
+        capture(entt::registry &registry) const override
+        {
+            auto const *value = registry.ctx().find<T>();
+            if (value == nullptr) {
+                return {};
+            }
+            auto bytes = std::as_bytes(std::span{value, 1});
+            return {bytes.begin(), bytes.end()};
+        }
+
+        void restore(entt::registry &registry,
+                     std::span<std::byte const> value) const override
+        {
+            if (value.size() != sizeof(T)) {
+                return;
+            }
+            T restored;
+            std::memcpy(&restored, value.data(), sizeof(T));
+            registry.ctx().insert_or_assign(restored);
+        }
+    };
+
+    std::vector<std::unique_ptr<Pool>> pools_;
+    std::vector<std::unique_ptr<Context_var>> contexts_;
+};
+
+/// @brief Saves snapshots in the background.
+///
+/// The world is captured on the calling (tick) thread; encoding, compressing
+/// and writing the file run on the thread pool, so a save costs the frame
+/// only the copy. Every `full_every`th save is full and the rest are
+/// incremental against the last full one, so loading takes the full
+/// snapshot plus at most one incremental.
+///
+/// Lives in the registry's context.
+class Snapshot_saver {
+  public:
+    static constexpr std::size_t full_every{10};
+
+    Snapshot_saver(Snapshot_schema schema, std::filesystem::path directory,
+                   Thread_pool &pool);
+    Snapshot_saver(Snapshot_saver const &) = delete;
+    Snapshot_saver(Snapshot_saver &&) = delete;
+    Snapshot_saver &operator=(Snapshot_saver const &) = delete;
+    Snapshot_saver &operator=(Snapshot_saver &&) = delete;
+    ~Snapshot_saver();
+
+    // Captures the world and starts writing it, unless the last save is
+    // still being written. Returns whether it started.
+    bool save(entt::registry &registry, std::uint64_t tick);
+
+    // Loads the newest full snapshot in the directory and the newest
+    // incremental one on top of it, after any save being written. The next
+    // save is full. `reset` runs right before the world is replaced, to drop
+    // what other services keep about it. Returns false if there is no
+    // snapshot.
+    bool load_latest(entt::registry &registry,
+                     std::function<void()> const &reset);
+
+    [[nodiscard]] Snapshot_schema const &schema() const
+    {
+        return schema_;
+    }
+
+  private:
+    Snapshot_schema schema_;
+    std::filesystem::path directory_;
+    Thread_pool *pool_;
+    std::size_t saves_{};
+    std::future<void> saving_;
+    // The last full snapshot; only the save job touches it, and one runs at
+    // a time.
+    std::shared_ptr<World_image const> base_;
+};
@@ -0,0 +1,93 @@
+#pragma once
+#include <cstddef>
+#include <span>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+// Names a column of a Soa_table and the type of its elements, e.g.
+// `struct Armor : Soa_column<int> {};`.
+template <typename T>
+struct Soa_column {
+    using type = T;
+};
+
+/// @brief Rows of records stored as one contiguous array per column.
+///
+/// The column set is fixed at compile time by the tag types it is
+/// instantiated with, and columns are looked up by tag, so a loop over the
+/// table reads only the arrays it names. Rows are addressed by index.
+template <typename... Columns>
+class Soa_table {
+    template <typename C>
+    static constexpr std::size_t index_of()
+    {
+        constexpr bool matches[]{std::is_same_v<C, Columns>...};
+        static_assert((std::is_same_v<C, Columns> + ...) == 1,
+                      "not a column of this table");
+        std::size_t i{};
+        while (!matches[i]) {
+            ++i;
+        }
+        return i;
+    }
+
+  public:
+    [[nodiscard]] std::size_t size() const
+    {
+        return std::get<0>(columns_).size();
+    }
+
+    void reserve(std::size_t rows)
+    {
+        std::apply([&](auto &...column) { (column.reserve(rows), ...); },
+                   columns_);
+    }
+
+    void clear()
+    {
+        std::apply([](auto &...column) { (column.clear(), ...); }, columns_);
+    }
+
+    // Returns the new row's index.
+    std::size_t push_back(typename Columns::type const &...values)
+    {
+        auto row = size();
+        std::apply(
+            [&](auto &...column) { (column.push_back(values), ...); },
+            columns_);
+        return row;
+    }
+
+    // Appends as many rows as the columns given, which must all be as long.
+    void append(std::span<typename Columns::type const>... values)
+    {
+        auto rows = std::get<0>(std::tie(values...)).size();
+        if (((values.size() != rows) || ...)) {
+            spdlog::error("Soa_table: appending columns of different lengths");
+            throw std::runtime_error("check last error");
+        }
+        std::apply(
+            [&](auto &...column) {
+                (column.insert(column.end(), values.begin(), values.end()),
+                 ...);
+            },
+            columns_);
+    }
+
+    template <typename C>
+    [[nodiscard]] std::span<typename C::type const> column() const
+    {
+        return std::get<index_of<C>()>(columns_);
+    }
+    template <typename C>
+    [[nodiscard]] std::span<typename C::type> column()
+    {
+        return std::get<index_of<C>()>(columns_);
+    }
+
+  private:
+    std::tuple<std::vector<typename Columns::type>...> columns_;
+};
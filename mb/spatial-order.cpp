@@ -0,0 +1,135 @@
+#include <mb/spatial-order.h>
+
+#include <mb/components.h>
+#include <mb/thread-pool.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <spdlog/spdlog.h>
+
+namespace {
+
+using Keyed = std::vector<std::pair<std::uint32_t, entt::entity>>;
+
+// Cell coordinate biased to be unsigned; 16 bits, ~±130k units either way.
+std::uint32_t cell_of(float v)
+{
+    auto cell = static_cast<int>(std::floor(v / morton_cell)) + 0x8000;
+    return static_cast<std::uint32_t>(std::clamp(cell, 0, 0xFFFF));
+}
+
+// Moves bit i of the low 16 bits to bit 2i.
+std::uint32_t spread_bits(std::uint32_t v)
+{
+    v = (v | (v << 8)) & 0x00FF'00FF;
+    v = (v | (v << 4)) & 0x0F0F'0F0F;
+    v = (v | (v << 2)) & 0x3333'3333;
+    v = (v | (v << 1)) & 0x5555'5555;
+    return v;
+}
+
+std::vector<entt::entity> sorted(Keyed keyed)
+{
+    std::ranges::sort(keyed, {}, &Keyed::value_type::first);
+    std::vector<entt::entity> order;
+    order.reserve(keyed.size());
+    for (auto [key, e] : keyed) {
+        order.push_back(e);
+    }
+    return order;
+}
+
+} // namespace
+
+std::uint32_t morton_key(glm::vec3 pos)
+{
+    return spread_bits(cell_of(pos.x)) | (spread_bits(cell_of(pos.z)) << 1);
+}
+
+Spatial_order::~Spatial_order()
+{
+    if (sorting_.valid()) {
+        sorting_.wait();
+    }
+}
+
+void Spatial_order::reset()
+{
+    if (sorting_.valid()) {
+        sorting_.get();
+    }
+    order_.clear();
+    next_ = 0;
+    placed_ = 0;
+    size_ = 0;
+}
+
+void Spatial_order::step(entt::registry &registry, std::size_t budget)
+{
+    // The group of movement_system, which arranges these pools.
+    auto movers = registry.group<Position, Velocity>();
+    auto &positions = registry.storage<Position>();
+    auto &velocities = registry.storage<Velocity>();
+
+    // Leaving the group moves entities into the placed front.
+    if (movers.size() < size_) {
+        next_ = order_.size();
+    }
+    size_ = movers.size();
+
+    for (; budget != 0 && next_ != order_.size(); --budget) {
+        auto e = order_[next_++];
+        if (!movers.contains(e)) {
+            continue;
+        }
+        // Everything before `target` was placed this pass, so `e` is at or
+        // after it.
+        auto target = placed_++;
+        if (target >= movers.size()) {
+            next_ = order_.size();
+            break;
+        }
+        auto other = positions.data()[target];
+        if (other == e) {
+            continue;
+        }
+        positions.swap_elements(e, other);
+        velocities.swap_elements(e, other);
+    }
+    if (next_ != order_.size()) {
+        return;
+    }
+
+    if (!sorting_.valid()) {
+        if (!order_.empty()) {
+            // Armies are visited through their own pool; keep it in step.
+            // sort_as takes entities, so Position's sparse set, not its
+            // components.
+            auto const &base =
+                static_cast<entt::sparse_set const &>(positions);
+            registry.storage<Army>().sort_as(base.begin(), base.end());
+            order_.clear();
+        }
+        Keyed keys;
+        keys.reserve(movers.size());
+        for (auto e : movers) {
+            keys.emplace_back(morton_key(positions.get(e).value), e);
+        }
+        sorting_ = pool_->submit(
+            [keys = std::move(keys)]() mutable {
+                return sorted(std::move(keys));
+            });
+        return;
+    }
+    if (sorting_.wait_for(std::chrono::seconds{0}) !=
+        std::future_status::ready) {
+        return;
+    }
+    order_ = sorting_.get();
+    next_ = 0;
+    placed_ = 0;
+    ++passes_;
+    spdlog::debug("Spatial_order: pass {} over {} movers", passes_,
+                  order_.size());
+}
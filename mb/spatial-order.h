@@ -0,0 +1,62 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <entt/entt.hpp>
+#include <future>
+#include <glm/glm.hpp>
+#include <vector>
+
+class Thread_pool;
+
+// Side of the XZ cells entities are ordered by, in world units.
+constexpr float morton_cell{4};
+
+// Position of `pos`'s XZ cell along the Z-order curve: cells close on the
+// map are mostly close on the curve.
+std::uint32_t morton_key(glm::vec3 pos);
+
+/// @brief Keeps movers stored in Z-order of their XZ cell.
+///
+/// Works on the pools movement_system's group owns, Position and Velocity.
+/// A pass captures every mover's key, sorts them on the thread pool and then
+/// moves entities into place a bounded number per frame, swapping the same
+/// pair in both pools so that the group stays aligned; at its end, Army is
+/// sorted to follow. New entities wait for the next pass; if the group
+/// shrinks, the pass is dropped. Armies move slowly, so the order the pools
+/// converge to is close to current.
+///
+/// Lives in the registry's context.
+class Spatial_order {
+  public:
+    // Entities placed per frame; each costs at most one swap per pool.
+    static constexpr std::size_t default_budget{512};
+
+    explicit Spatial_order(Thread_pool &pool) : pool_{&pool} {}
+    Spatial_order(Spatial_order const &) = delete;
+    Spatial_order(Spatial_order &&) = delete;
+    Spatial_order &operator=(Spatial_order const &) = delete;
+    Spatial_order &operator=(Spatial_order &&) = delete;
+    ~Spatial_order();
+
+    // Places at most `budget` entities of the current pass, then starts the
+    // next pass once this one is through.
+    void step(entt::registry &registry, std::size_t budget = default_budget);
+
+    // Drops the current pass, and the sort in flight, e.g. because the
+    // world was replaced.
+    void reset();
+
+    [[nodiscard]] std::size_t passes() const
+    {
+        return passes_;
+    }
+
+  private:
+    Thread_pool *pool_;
+    std::future<std::vector<entt::entity>> sorting_;
+    std::vector<entt::entity> order_;
+    std::size_t next_{};   // into order_
+    std::size_t placed_{}; // at the front of the group
+    std::size_t size_{};   // of the group at the last step
+    std::size_t passes_{};
+};
@@ -3,20 +3,23 @@
 #include <mb/components.h>
 #include <mb/events.h>
 #include <mb/game.h>
-#include <mb/get-terrain-height.h>
+#include <mb/height-field.h>
 #include <mb/helpers.h>
 #include <mb/lights.h>
 #include <mb/mesh.h>
 #include <mb/model.h>
+#include <mb/movement.h>
+#include <mb/render-queue.h>
 #include <mb/shader-program.h>
+#include <mb/thread-pool.h>
 #include <mb/town.h>
 
+#include <array>
 #include <random>
 // FIXME: Should be removed: ECS shouldn't depend on particular glfwTime.
 #include <GLFW/glfw3.h>
 
-void movement_system(entt::registry &reg, float dt,
-                     std::vector<std::vector<float>> const &mountain_height)
+void movement_system(entt::registry &reg, Thread_pool &pool, float dt)
 {
     // Simulates movement of sun
     auto dlights = reg.view<Directional_light>();
@@ -27,39 +30,41 @@ void movement_system(entt::registry &reg, float dt,
             glm::vec3(cos(angle), -sin(angle), sin(angle) * 0.5f));
     }
 
-    // Moves those have velocity to their direction.
-    if (mountain_height.empty() || mountain_height[0].empty()) {
-        throw std::runtime_error(
-            "Invalid mountain height data (size too small)");
-    }
-    auto moveables = reg.view<Position, Velocity>().each();
-    for (auto [entity, pos, vel] : moveables) {
-        if (glm::length(vel.dir) < 1e-5) { // Regarded as still
-            continue;
-        }
-        pos.value += glm::normalize(vel.dir) * vel.speed * dt;
-
-        if (reg.all_of<Army>(entity)) {
-            pos.value.y =
-                get_terrain_height(mountain_height, pos.value.x, pos.value.z);
-        }
-
-        auto p = pos.value;
-        spdlog::debug("entity {} pos={},{},{}",
-                      static_cast<std::size_t>(entity), p.x, p.y, p.z);
-    }
-
-    // Simulates 手电筒灯光 (跟随摄像机)
-    auto slights = reg.view<Light, Spot_light, Position>();
-    auto cameras = reg.view<Camera, View_mode>();
-    for (auto [entity, light, slight, pos] : slights.each()) {
-        for (auto [cam_entity, cam, view_mode] : cameras.each()) {
-            if (view_mode == View_mode::First_player) {
-                pos.value = reg.get<Position>(cam_entity).value;
-                slight.dir = reg.get<Camera>(cam_entity).front();
+    // Moves those have velocity to their direction. The group owns its
+    // pools, which keeps every mover's Position and Velocity at the same
+    // index at the front of both; so the kernel runs down the pools' pages.
+    auto movers = reg.group<Position, Velocity>();
+    auto &positions = reg.storage<Position>();
+    auto const &velocities = reg.storage<Velocity>();
+    constexpr auto page = entt::component_traits<Position>::page_size;
+    static_assert(entt::component_traits<Velocity>::page_size == page);
+    // Chunks are whole pages, so each is contiguous.
+    pool.parallel_for(movers.size(), page, [&](std::size_t begin,
+                                               std::size_t end) {
+        integrate_movement(
+            std::span{positions.raw()[begin / page], end - begin},
+            std::span{velocities.raw()[begin / page], end - begin}, dt);
+    });
+
+    // Army isn't owned: a second owning group on the same pools would
+    // conflict with the one above. Armies are gathered a batch at a time.
+    auto const &armies = reg.storage<Army>();
+    auto const &terrain = reg.ctx().get<Height_field>();
+    pool.parallel_for(armies.size(), page, [&](std::size_t begin,
+                                               std::size_t end) {
+        std::array<Position *, movement_lanes> batch{};
+        std::size_t n{};
+        for (auto i = begin; i != end; ++i) {
+            auto e = armies.data()[i];
+            if (positions.contains(e)) {
+                batch[n++] = &positions.get(e);
+            }
+            if (n == batch.size() || (i + 1 == end && n != 0)) {
+                snap_to_terrain(std::span{batch.data(), n}, terrain);
+                n = 0;
             }
         }
-    }
+    });
 }
 void collision_system(entt::registry &registry, entt::dispatcher &dispatcher,
                       float dt)
@@ -110,22 +115,66 @@ void collision_system(entt::registry &registry, entt::dispatcher &dispatcher,
                 dispatcher.trigger(Collision_event{
                     .registry = &registry, .self{self}, .other{other}});
             }
+            else if (registry.all_of<Army>(e1) && registry.all_of<Army>(e2)) {
+                dispatcher.enqueue(Battle_event{
+                    .registry = &registry, .first = e1, .second = e2});
+            }
             collision_free.insert({enttpair, 1});
         }
     }
 }
 
-void render_system(entt::registry &registry, glm::mat4 const &proj)
+void track_world_matrices(entt::registry &registry)
+{
+    constexpr auto mark =
+        &entt::registry::emplace_or_replace<World_matrix_dirty>;
+    registry.on_construct<Position>().connect<mark>();
+    registry.on_update<Position>().connect<mark>();
+    registry.on_construct<Transform>().connect<mark>();
+    registry.on_update<Transform>().connect<mark>();
+    registry.on_destroy<Transform>().connect<mark>();
+    registry.on_construct<Renderable>().connect<mark>();
+}
+
+void world_matrix_system(entt::registry &registry)
+{
+    auto dirty = registry.view<World_matrix_dirty, Renderable, Position>();
+    for (auto e : dirty) {
+        World_matrix world;
+        if (auto const *trans = registry.try_get<Transform>(e)) {
+            auto rotx = glm::angleAxis(trans->rotation.x, glm::vec3{1, 0, 0});
+            auto roty = glm::angleAxis(trans->rotation.y, glm::vec3{0, 1, 0});
+            auto rotz = glm::angleAxis(trans->rotation.z, glm::vec3{0, 0, 1});
+            auto rotation = glm::mat3_cast(rotz * roty * rotx);
+            // The inverse transpose of rotation * scale is rotation / scale.
+            for (int i{}; i != 3; ++i) {
+                world.model[i] = glm::vec4(rotation[i] * trans->scale[i], 0);
+                world.normal[i] = rotation[i] / trans->scale[i];
+            }
+        }
+        world.model[3] = glm::vec4(dirty.get<Position>(e).value, 1);
+        registry.emplace_or_replace<World_matrix>(e, world);
+    }
+    registry.clear<World_matrix_dirty>();
+
+    // Translation is the only thing movement changes.
+    auto movers = registry.view<World_matrix, Position, Velocity>();
+    for (auto [e, world, pos, vel] : movers.each()) {
+        world.model[3] = glm::vec4(pos.value, 1);
+    }
+}
+
+void render_system(entt::registry &registry, Render_queue &queue,
+                   glm::mat4 const &proj)
 {
     auto view_mat = get_active_view_mat(registry);
 
-    auto renderables = registry.view<Renderable, Position>();
+    auto renderables = registry.view<Renderable, World_matrix>();
     auto me = get_first_local_player(registry);
-    auto const &myperc = registry.get<Army>(me).perception;
-    for (auto [e, renderable, pos] : renderables.each()) {
+    auto const &visible = registry.get<Visibility>(me).visible;
+    for (auto [e, renderable, world] : renderables.each()) {
         // Unseenable armies for us (local player)
-        if (registry.all_of<Army>(e) &&
-            !std::ranges::contains(myperc.viewable_entity, e)) {
+        if (e != me && registry.all_of<Army>(e) && !visible.test(e)) {
             continue;
         }
 
@@ -140,27 +189,22 @@ void render_system(entt::registry &registry, glm::mat4 const &proj)
             throw std::runtime_error("check last error");
         }
 
-        glm::mat4 model(1.);
-        model = glm::translate(model, pos.value);
-        if (registry.all_of<Transform>(e)) { // Scale and rotation
-            auto const &trans = registry.get<Transform>(e);
-            model = glm::scale(model, trans.scale);
-            auto rotx = glm::angleAxis(trans.rotation.x, glm::vec3{1, 0, 0});
-            auto roty = glm::angleAxis(trans.rotation.y, glm::vec3{0, 1, 0});
-            auto rotz = glm::angleAxis(trans.rotation.z, glm::vec3{0, 0, 1});
-            model = glm::mat4(rotz * roty * rotx) * model;
+        std::span<glm::mat4 const> palette;
+        if (auto const *animator = registry.try_get<Animator>(e)) {
+            palette = animator->palette;
         }
-        shader->uniform_mat3("transposed_inverse_model",
-                             glm::transpose(glm::inverse(model)));
-        shader->uniform_mat4("model", model);
-        shader->uniform_mat4("view", view_mat);
-        shader->uniform_mat4("projection", proj);
-        uniform_lights(registry, *shader);
-        auto cam = get_active_camera(registry);
-        shader->uniform_vec3("cameraPos", registry.get<Position>(cam).value);
-
-        renderable.model->render(*shader);
+        renderable.model->submit(queue, *shader, world.model, world.normal,
+                                 palette);
     }
+
+    auto cam = get_active_camera(registry);
+    auto cam_pos = registry.get<Position>(cam).value;
+    queue.flush([&](Shader_program const &shader) {
+        shader.uniform_mat4("view", view_mat);
+        shader.uniform_mat4("projection", proj);
+        uniform_lights(registry, shader);
+        shader.uniform_vec3("cameraPos", cam_pos);
+    });
 }
 
 void town_script(entt::registry &reg, float dt)
@@ -187,6 +231,7 @@ void town_script(entt::registry &reg, float dt)
 void collision_script(entt::registry &reg, entt::dispatcher &disp)
 {
     disp.update<Collision_event>();
+    disp.update<Battle_event>();
 }
 
 void camera_script(entt::registry &reg, GLFWwindow *window,
@@ -4,31 +4,52 @@
 #include <entt/entt.hpp>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
-#include <random>
 
 constexpr float view_dist{10};
+// How much farther than view_dist an army in view has to go to leave it.
+constexpr float view_hysteresis{1};
 
-bool chance(float p);
+// Runs the AI armies whose turn it is, see Ai_scheduler.
+void ai_system(entt::registry &registry);
 
-void ai_system(entt::registry &registry, float dt);
-
-void movement_system(entt::registry &registry, float dt,
-                     std::vector<std::vector<float>> const &mountain_height);
+class Thread_pool;
+// Moves everything with a Velocity and keeps armies on the Height_field;
+// batches of movement_lanes entities, pages of them spread over `pool`.
+void movement_system(entt::registry &registry, Thread_pool &pool, float dt);
 
 void collision_system(entt::registry &registry, entt::dispatcher &dispatcher,
                       float dt);
 
-class Shader_program;
-void render_system(entt::registry &registry, glm::mat4 const &proj);
+// Tags entities World_matrix_dirty whenever Position, Transform or
+// Renderable is emplaced or patched, and when Transform is removed.
+void track_world_matrices(entt::registry &registry);
+
+// Rebuilds the World_matrix of dirty renderables and follows movers, whose
+// Position is written in place.
+void world_matrix_system(entt::registry &registry);
+
+class Render_queue;
+void render_system(entt::registry &registry, Render_queue &queue,
+                   glm::mat4 const &proj);
 
-// Feel environment
-void perception_system(entt::registry &registry);
+// Advances every Animator and evaluates its skinning palette on `pool`.
+void animation_system(entt::registry &registry, Thread_pool &pool, float dt);
+
+// Feel environment; emits Entered_view and Left_view through `dispatcher`.
+void perception_system(entt::registry &registry, entt::dispatcher &dispatcher);
 
 void town_script(entt::registry &reg, float dt);
 
+// Starts each economy day in the background and copies published prices to
+// the markets' items.
+void economy_system(entt::registry &reg);
+
 void collision_script(entt::registry &reg, entt::dispatcher &disp);
 
 void camera_script(entt::registry &reg, GLFWwindow *window,
                    View_mode current_view_mode);
 
+// Builds the flow fields pathing_system follows towards chased entities.
+void flow_field_system(entt::registry &reg, Thread_pool &pool);
+
 void pathing_system(entt::registry &reg);
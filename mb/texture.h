@@ -3,13 +3,16 @@
 
 #include <filesystem>
 #include <glad/gl.h>
+#include <span>
 #include <stb_image.h>
 
 /// @brief Texture owns the resource, and has reference to it.
 class Texture {
   public:
     Texture(Texture const &) = delete;
-    Texture(Texture &&other) noexcept : texture_{other.texture_}
+    Texture(Texture &&other) noexcept
+        : texture_{other.texture_}, width_{other.width_},
+          height_{other.height_}
     {
         other.texture_ = 0;
     }
@@ -28,10 +31,27 @@ class Texture {
             throw std::runtime_error("check last error");
         }
         GLenum format = channels == 3 ? GL_RGB : GL_RGBA;
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, format,
-                     GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-        check_gl_errors();
+        upload(width, height, format, data);
+        stbi_image_free(data);
+    }
+
+    // Decodes an image file already read into memory (png, jpg, ...).
+    Texture(std::span<unsigned char const> encoded, bool flip_vertically)
+        : texture_{gen_texture()}
+    {
+        int width;
+        int height;
+        int channels;
+        stbi_set_flip_vertically_on_load(static_cast<int>(flip_vertically));
+        unsigned char *data = stbi_load_from_memory(
+            encoded.data(), static_cast<int>(encoded.size()), &width, &height,
+            &channels, 4);
+        if (data == nullptr) {
+            spdlog::error("Failed to decode texture from memory: {}",
+                          stbi_failure_reason());
+            throw std::runtime_error("check last error");
+        }
+        upload(width, height, GL_RGBA, data);
         stbi_image_free(data);
     }
 
@@ -41,10 +61,7 @@ class Texture {
         if (data == nullptr) {
             throw std::invalid_argument("data is nullptr");
         }
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, format,
-                     GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-        check_gl_errors();
+        upload(width, height, format, data);
     }
 
     ~Texture()
@@ -81,7 +98,24 @@ class Texture {
         return texture_ == 0;
     }
 
+    // Approximate VRAM usage: RGBA8 storage plus a third for the mip chain.
+    [[nodiscard]] std::size_t size_in_bytes() const
+    {
+        auto base = static_cast<std::size_t>(width_) * height_ * 4;
+        return base + (base / 3);
+    }
+
   private:
+    void upload(int width, int height, GLenum format, unsigned char const *data)
+    {
+        width_ = width;
+        height_ = height;
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, format,
+                     GL_UNSIGNED_BYTE, data);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        check_gl_errors();
+    }
+
     static GLuint gen_texture()
     {
         GLuint texture;
@@ -99,6 +133,8 @@ class Texture {
     }
 
     GLuint texture_;
+    int width_{};
+    int height_{};
     int slot_;
 };
 
@@ -0,0 +1,107 @@
+#include <mb/thread-pool.h>
+
+#include <algorithm>
+#include <atomic>
+#include <spdlog/spdlog.h>
+
+Thread_pool::Thread_pool(std::size_t threads)
+{
+    threads_.reserve(threads);
+    for (std::size_t i{}; i != threads; ++i) {
+        threads_.emplace_back(
+            [this](std::stop_token const &stop) { work(stop); });
+    }
+    spdlog::info("Thread pool started with {} workers", threads);
+}
+
+Thread_pool::~Thread_pool()
+{
+    for (auto &thread : threads_) {
+        thread.request_stop();
+    }
+    wake_.notify_all();
+    threads_.clear();
+}
+
+std::size_t Thread_pool::default_thread_count()
+{
+    auto cores = std::thread::hardware_concurrency();
+    return cores > 1 ? cores - 1 : 1;
+}
+
+void Thread_pool::enqueue(std::function<void()> job)
+{
+    {
+        std::scoped_lock lock{mutex_};
+        jobs_.push_back(std::move(job));
+    }
+    wake_.notify_one();
+}
+
+void Thread_pool::work(std::stop_token const &stop)
+{
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock lock{mutex_};
+            if (!wake_.wait(lock, stop, [this] { return !jobs_.empty(); })) {
+                return;
+            }
+            job = std::move(jobs_.front());
+            jobs_.pop_front();
+        }
+        job();
+    }
+}
+
+void Thread_pool::parallel_for(
+    std::size_t count, std::size_t grain,
+    std::function<void(std::size_t, std::size_t)> const &body)
+{
+    if (count == 0) {
+        return;
+    }
+    grain = std::max<std::size_t>(grain, 1);
+    auto chunks = (count + grain - 1) / grain;
+    if (chunks == 1 || threads_.empty()) {
+        body(0, count);
+        return;
+    }
+
+    // Chunks are claimed dynamically so that a slow one doesn't hold up the
+    // others. The caller keeps claiming until none are left, so it never
+    // depends on a helper getting a worker: a helper that starts late finds
+    // nothing to do. That makes calls from inside a job safe, even with a
+    // single worker. State is shared so that late helpers never touch this
+    // frame.
+    struct Shared {
+        std::function<void(std::size_t, std::size_t)> const *body;
+        std::size_t count;
+        std::size_t grain;
+        std::size_t chunks;
+        std::atomic<std::size_t> next{};
+        std::atomic<std::size_t> left;
+    };
+    auto shared = std::make_shared<Shared>(&body, count, grain, chunks);
+    shared->left = chunks;
+    auto run = [](Shared &s) {
+        for (auto chunk = s.next++; chunk < s.chunks; chunk = s.next++) {
+            auto begin = chunk * s.grain;
+            (*s.body)(begin, std::min(begin + s.grain, s.count));
+            if (--s.left == 0) {
+                s.left.notify_all();
+            }
+        }
+    };
+
+    auto helpers = std::min(chunks - 1, threads_.size());
+    for (std::size_t i{}; i != helpers; ++i) {
+        enqueue([shared, run] { run(*shared); });
+    }
+    run(*shared);
+    // Wait for the chunks helpers are still running.
+    for (auto left = shared->left.load(); left != 0;
+         left = shared->left.load()) {
+        shared->left.wait(left);
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/// @brief A fixed set of worker threads shared by every system that wants to
+/// spread work over cores.
+///
+/// `parallel_for` is for data-parallel work inside a frame; the calling thread
+/// takes part and the call returns once every chunk is done. `submit` is for
+/// background jobs whose result is picked up later through a future.
+class Thread_pool {
+  public:
+    // Defaults to one worker per core but the calling one.
+    explicit Thread_pool(std::size_t threads = default_thread_count());
+    Thread_pool(Thread_pool const &) = delete;
+    Thread_pool(Thread_pool &&) = delete;
+    Thread_pool &operator=(Thread_pool const &) = delete;
+    Thread_pool &operator=(Thread_pool &&) = delete;
+    ~Thread_pool();
+
+    template <typename F>
+    std::future<std::invoke_result_t<F>> submit(F &&job)
+    {
+        using Result = std::invoke_result_t<F>;
+        auto task = std::make_shared<std::packaged_task<Result()>>(
+            std::forward<F>(job));
+        auto future = task->get_future();
+        enqueue([task] { (*task)(); });
+        return future;
+    }
+
+    // Calls `body(begin, end)` on disjoint chunks covering [0, count), each
+    // at least `grain` long (but the last). `body` must not throw.
+    void parallel_for(
+        std::size_t count, std::size_t grain,
+        std::function<void(std::size_t, std::size_t)> const &body);
+
+    [[nodiscard]] std::size_t size() const
+    {
+        return threads_.size();
+    }
+
+    static std::size_t default_thread_count();
+
+  private:
+    void enqueue(std::function<void()> job);
+    void work(std::stop_token const &stop);
+
+    std::mutex mutex_;
+    std::condition_variable_any wake_;
+    std::deque<std::function<void()>> jobs_;
+    // Last so that workers are joined before the queue is destroyed.
+    std::vector<std::jthread> threads_;
+};
@@ -1,6 +1,8 @@
 #pragma once
+#include <mb/small-vector.h>
+
 #include <entt/entt.hpp>
-#include <vector>
+#include <string>
 
 namespace component {
 
@@ -10,8 +12,11 @@ struct Item {
     float price;
 };
 
+// A market's Items; a town trades in a handful of goods.
+using Market_items = Small_vector<entt::entity, 8>;
+
 struct Market {
-    std::vector<entt::entity> items; // vector of Items
+    Market_items items; // vector of Items
 };
 
 // Town_tag should own Market component.
@@ -0,0 +1,52 @@
+#include <mb/troop.h>
+
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+
+Troop_roster::Troop_roster() : Troop_roster{std::span<Troop const>{}} {}
+
+Troop_roster::Troop_roster(std::span<Troop const> troops)
+{
+    levy_.push_back(levy.armor, levy.weapon_damage, levy.speed, levy.upkeep,
+                    levy.tier, levy.upgrade);
+    load(troops);
+}
+
+void Troop_roster::load(std::span<Troop const> troops)
+{
+    // Transposed first, so that the table grows a whole column at a time.
+    auto column = [&](auto member) {
+        std::vector<std::remove_cvref_t<decltype(Troop{}.*member)>> values;
+        values.reserve(troops.size());
+        for (auto const &t : troops) {
+            values.push_back(t.*member);
+        }
+        return values;
+    };
+    table_.append(column(&Troop::armor), column(&Troop::weapon_damage),
+                  column(&Troop::speed), column(&Troop::upkeep),
+                  column(&Troop::tier), column(&Troop::upgrade));
+}
+
+float army_speed(Army const &army, Troop_roster const &roster)
+{
+    if (army.stacks.empty()) {
+        return Troop_roster::levy.speed;
+    }
+    auto slowest = roster.get<troop::Speed>(army.stacks.front().troop_id);
+    for (auto const &stack : army.stacks) {
+        slowest = std::min(slowest, roster.get<troop::Speed>(stack.troop_id));
+    }
+    return slowest;
+}
+
+float army_upkeep(Army const &army, Troop_roster const &roster)
+{
+    float upkeep{};
+    for (auto const &stack : army.stacks) {
+        upkeep += static_cast<float>(stack.size) *
+                  roster.get<troop::Upkeep>(stack.troop_id);
+    }
+    return upkeep;
+}
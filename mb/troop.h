@@ -1,12 +1,84 @@
 #pragma once
+#include <mb/entity-bitset.h>
+#include <mb/small-vector.h>
+#include <mb/soa-table.h>
+
+#include <cstddef>
 #include <entt/entt.hpp>
+#include <span>
 #include <vector>
 
 // =======TROOP=========
 
+// Id of no troop, e.g. the upgrade of a troop that has none.
+inline constexpr std::size_t no_troop{-1UZ};
+
+// Columns of the troop database.
+namespace troop {
+
+struct Armor : Soa_column<int> {};
+struct Damage : Soa_column<int> {};
+struct Speed : Soa_column<float> {};  // world units per second
+struct Upkeep : Soa_column<float> {}; // money per soldier per economy day
+struct Tier : Soa_column<int> {};
+struct Upgrade : Soa_column<std::size_t> {}; // troop id, or no_troop
+
+} // namespace troop
+
+// One troop as a record, for loading the roster.
 struct Troop {
     int armor;
     int weapon_damage;
+    float speed;
+    float upkeep;
+    int tier;
+    std::size_t upgrade;
+};
+
+/// @brief Every kind of troop, indexed by Troop_stack::troop_id.
+///
+/// Stored a column per stat, so that combat, upkeep and speed computations
+/// each read only the stats they need. Ids beyond the roster are levies.
+/// Lives in the registry's context.
+class Troop_roster {
+  public:
+    using Table = Soa_table<troop::Armor, troop::Damage, troop::Speed,
+                            troop::Upkeep, troop::Tier, troop::Upgrade>;
+
+    // What stacks of unknown troops are.
+    static constexpr Troop levy{.armor = 0,
+                                .weapon_damage = 2,
+                                .speed = 20,
+                                .upkeep = 0.5F,
+                                .tier = 0,
+                                .upgrade = no_troop};
+
+    Troop_roster();
+    explicit Troop_roster(std::span<Troop const> troops);
+
+    // Appends `troops`, the first getting id size().
+    void load(std::span<Troop const> troops);
+
+    [[nodiscard]] std::size_t size() const
+    {
+        return table_.size();
+    }
+    [[nodiscard]] Table const &table() const
+    {
+        return table_;
+    }
+
+    // Stat C of troop `id`.
+    template <typename C>
+    [[nodiscard]] typename C::type get(std::size_t id) const
+    {
+        return id < table_.size() ? table_.column<C>()[id]
+                                  : levy_.column<C>()[0];
+    }
+
+  private:
+    Table table_;
+    Table levy_;
 };
 
 struct Troop_stack {
@@ -14,16 +86,34 @@ struct Troop_stack {
     std::size_t troop_id;
 };
 
+// Sized for the stacks an army usually has and the armies it usually sees.
+using Army_stacks = Small_vector<Troop_stack, 8>;
+using Army_list = Small_vector<entt::entity, 16>;
+
 namespace internal {
 
 struct Perception {
-    std::vector<entt::entity> viewable_entity;
+    // Other armies in view, sorted; maintained by perception_system.
+    Army_list viewable_entity;
 };
 
 } // namespace internal
 
+// The armies a viewer can see, for O(1) tests. Only viewers that need it get
+// one (the local player, for fog of war); perception_system keeps it in step
+// with their Perception.
+struct Visibility {
+    Entity_bitset visible;
+};
+
 struct Army {
-    std::vector<Troop_stack> stacks; // 例如 [100步兵, 50骑兵]
+    Army_stacks stacks; // 例如 [100步兵, 50骑兵]
     internal::Perception perception;
     float money;
 };
+
+// Speed of the slowest troop in `army`.
+float army_speed(Army const &army, Troop_roster const &roster);
+
+// Money `army` costs per economy day.
+float army_upkeep(Army const &army, Troop_roster const &roster);
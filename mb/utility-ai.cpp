@@ -0,0 +1,197 @@
+#include <mb/utility-ai.h>
+
+#include <mb/simd.h>
+#include <mb/systems.h>
+
+namespace {
+
+// Armies neither chase nor flee at these odds of winning.
+constexpr float even_odds{0.5F};
+// Money at which trading is as tempting as it gets.
+constexpr float rich{500};
+// Towns farther than this aren't worth the trip.
+constexpr float market_reach{100};
+
+// The scoring below is written once over a lane type: float for one army, or
+// F4 for four at a time. Plain loops over floats don't vectorize here: with
+// the default -ftrapping-math the compiler keeps the clamps as branches.
+float lane_min(float a, float b)
+{
+    return a < b ? a : b;
+}
+float lane_max(float a, float b)
+{
+    return a > b ? a : b;
+}
+bool lane_less(float a, float b)
+{
+    return a < b;
+}
+float lane_select(bool mask, float a, float b)
+{
+    return mask ? a : b;
+}
+
+#ifdef MB_SSE2
+struct F4 {
+    __m128 v;
+
+    F4(__m128 v) : v{v} {} // NOLINT(google-explicit-constructor)
+    F4(float f) : v{_mm_set1_ps(f)} {} // NOLINT(google-explicit-constructor)
+};
+
+F4 operator+(F4 a, F4 b)
+{
+    return _mm_add_ps(a.v, b.v);
+}
+F4 operator-(F4 a, F4 b)
+{
+    return _mm_sub_ps(a.v, b.v);
+}
+F4 operator*(F4 a, F4 b)
+{
+    return _mm_mul_ps(a.v, b.v);
+}
+F4 operator/(F4 a, F4 b)
+{
+    return _mm_div_ps(a.v, b.v);
+}
+F4 lane_min(F4 a, F4 b)
+{
+    return _mm_min_ps(a.v, b.v);
+}
+F4 lane_max(F4 a, F4 b)
+{
+    return _mm_max_ps(a.v, b.v);
+}
+F4 lane_less(F4 a, F4 b)
+{
+    return _mm_cmplt_ps(a.v, b.v);
+}
+F4 lane_select(F4 mask, F4 a, F4 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v));
+}
+#endif
+
+template <typename V>
+struct Lanes {
+    V threat;
+    V threat_distance;
+    V odds;
+    V money;
+    V market_distance;
+    V rested;
+    V roll;
+};
+
+template <typename V>
+V saturate(V v)
+{
+    return lane_min(lane_max(v, V{0}), V{1});
+}
+
+template <typename V>
+V score(Ai_action action, Lanes<V> const &in)
+{
+    auto odds = in.odds;
+    // 1 right next to the closest army in view, 0 at view_dist.
+    auto proximity = saturate(V{1} - (in.threat_distance / V{view_dist}));
+    auto in_view = lane_less(V{0}, in.threat);
+
+    switch (action) {
+    case Ai_action::Idle:
+        return V{0.1F};
+    case Ai_action::Wander:
+        // The old 30% chance a second, now one option among others.
+        return in.rested * lane_select(lane_less(in.roll, V{0.3F}), V{0.2F},
+                                       V{0});
+    case Ai_action::Chase:
+        return lane_select(in_view, saturate((odds - V{even_odds}) * V{4}),
+                           V{0}) *
+               (V{0.6F} + (V{0.4F} * proximity));
+    case Ai_action::Flee:
+        return lane_select(in_view, saturate((V{even_odds} - odds) * V{4}),
+                           V{0}) *
+               (V{0.5F} + (V{0.5F} * proximity));
+    case Ai_action::Trade:
+        return in.rested * V{0.4F} * saturate(in.money / V{rich}) *
+               saturate(V{1} - (in.market_distance / V{market_reach}));
+    }
+    return V{0};
+}
+
+// Every action's score for the armies in `in`, keeping the best as it goes.
+template <typename V>
+V best_action(Lanes<V> const &in)
+{
+    V best{0};
+    V best_score{-1};
+    for (std::size_t a{}; a != ai_action_count; ++a) {
+        auto s = score(static_cast<Ai_action>(a), in);
+        auto better = lane_less(best_score, s);
+        best = lane_select(better, V{static_cast<float>(a)}, best);
+        best_score = lane_select(better, s, best_score);
+    }
+    return best;
+}
+
+Lanes<float> lanes_at(Ai_inputs const &in, std::size_t i)
+{
+    return {.threat = in.threat[i],
+            .threat_distance = in.threat_distance[i],
+            .odds = in.odds[i],
+            .money = in.money[i],
+            .market_distance = in.market_distance[i],
+            .rested = in.rested[i],
+            .roll = in.roll[i]};
+}
+
+#ifdef MB_SSE2
+Lanes<F4> lanes4_at(Ai_inputs const &in, std::size_t i)
+{
+    return {.threat = _mm_loadu_ps(in.threat.data() + i),
+            .threat_distance = _mm_loadu_ps(in.threat_distance.data() + i),
+            .odds = _mm_loadu_ps(in.odds.data() + i),
+            .money = _mm_loadu_ps(in.money.data() + i),
+            .market_distance = _mm_loadu_ps(in.market_distance.data() + i),
+            .rested = _mm_loadu_ps(in.rested.data() + i),
+            .roll = _mm_loadu_ps(in.roll.data() + i)};
+}
+#endif
+
+} // namespace
+
+Ai_inputs::Ai_inputs(std::pmr::memory_resource *memory)
+    : threat{memory}, threat_distance{memory}, odds{memory}, money{memory},
+      market_distance{memory}, rested{memory}, roll{memory}
+{
+}
+
+void Ai_inputs::resize(std::size_t n)
+{
+    for (auto *column : {&threat, &threat_distance, &odds, &money,
+                         &market_distance, &rested, &roll}) {
+        column->resize(n);
+    }
+}
+
+void choose_actions(Ai_inputs const &in, std::pmr::vector<Ai_action> &best)
+{
+    auto n = in.size();
+    best.resize(n);
+    std::size_t i{};
+#ifdef MB_SSE2
+    for (; i + 4 <= n; i += 4) {
+        alignas(16) std::int32_t actions[4];
+        _mm_store_si128(reinterpret_cast<__m128i *>(actions),
+                        _mm_cvttps_epi32(best_action(lanes4_at(in, i)).v));
+        for (std::size_t j{}; j != 4; ++j) {
+            best[i + j] = static_cast<Ai_action>(actions[j]);
+        }
+    }
+#endif
+    for (; i != n; ++i) {
+        best[i] = static_cast<Ai_action>(best_action(lanes_at(in, i)));
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+enum class Ai_action : std::int32_t { Idle, Wander, Chase, Flee, Trade };
+
+inline constexpr std::size_t ai_action_count{5};
+
+// What an army weighs when deciding, one array per consideration and one
+// element per army, so that scoring runs down contiguous floats.
+struct Ai_inputs {
+    explicit Ai_inputs(std::pmr::memory_resource *memory =
+                           std::pmr::get_default_resource());
+
+    // Troops of, and distance to, the closest army in view; 0 and
+    // view_dist when there is none.
+    std::pmr::vector<float> threat;
+    std::pmr::vector<float> threat_distance;
+    // Forecast chance of beating that army; 1 when there is none.
+    std::pmr::vector<float> odds;
+    std::pmr::vector<float> money;
+    std::pmr::vector<float> market_distance; // to the closest town
+    // 1 once Ai_cooldown ran out, else 0.
+    std::pmr::vector<float> rested;
+    // Uniform in [0, 1), fresh per decision.
+    std::pmr::vector<float> roll;
+
+    void resize(std::size_t n);
+    [[nodiscard]] std::size_t size() const
+    {
+        return threat.size();
+    }
+};
+
+/// @brief Scores every action for every army in `in` and writes each army's
+/// best to `best`.
+///
+/// Each action's score is a product of response curves over the inputs. One
+/// pass over the armies, four at a time with SSE2, scores all actions and
+/// keeps the best without branching.
+void choose_actions(Ai_inputs const &in, std::pmr::vector<Ai_action> &best);
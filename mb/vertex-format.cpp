@@ -0,0 +1,247 @@
+#include <mb/vertex-format.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <glm/gtc/packing.hpp>
+#include <limits>
+#include <utility>
+
+namespace {
+
+std::int16_t to_snorm16(float v)
+{
+    return static_cast<std::int16_t>(
+        std::round(std::clamp(v, -1.0F, 1.0F) * 32767.0F));
+}
+
+std::array<std::int16_t, 2> pack_normal(glm::vec3 n)
+{
+    auto e = octahedral_encode(n);
+    return {to_snorm16(e.x), to_snorm16(e.y)};
+}
+
+std::array<std::uint16_t, 2> pack_texcoord(glm::vec2 uv)
+{
+    return {glm::packHalf1x16(uv.x), glm::packHalf1x16(uv.y)};
+}
+
+Packed_skin pack_skin(Vertex const &v)
+{
+    Packed_skin skin{.joints = v.joints, .weights = {}};
+    float total = v.weights.x + v.weights.y + v.weights.z + v.weights.w;
+    if (total <= 0) {
+        return skin;
+    }
+    int sum{};
+    int heaviest{};
+    for (int i{}; i != 4; ++i) {
+        auto w = static_cast<int>(std::round(v.weights[i] / total * 255.0F));
+        skin.weights[i] = static_cast<std::uint8_t>(w);
+        sum += w;
+        if (v.weights[i] > v.weights[heaviest]) {
+            heaviest = i;
+        }
+    }
+    // Rounding may leave the sum off by a few; the heaviest influence absorbs
+    // the difference so that skinned vertices don't shrink or swell.
+    skin.weights[heaviest] =
+        static_cast<std::uint8_t>(skin.weights[heaviest] + (255 - sum));
+    return skin;
+}
+
+template <typename T>
+void append_bytes(std::vector<std::byte> &out, T const &value)
+{
+    auto const *p = reinterpret_cast<std::byte const *>(&value);
+    out.insert(out.end(), p, p + sizeof(T));
+}
+
+} // namespace
+
+GLsizei Vertex_layout::stride() const
+{
+    GLsizei skin = skinning == Skinning::None ? 0 : sizeof(Packed_skin);
+    switch (position) {
+    case Position_format::Float16:
+        return sizeof(Packed_vertex_half) + skin;
+    case Position_format::Float32:
+        return sizeof(Packed_vertex_float) + skin;
+    }
+    std::unreachable();
+}
+
+std::size_t Vertex_layout::index_size() const
+{
+    return index == Index_format::Uint16 ? sizeof(std::uint16_t)
+                                         : sizeof(std::uint32_t);
+}
+
+GLenum Vertex_layout::index_type() const
+{
+    return index == Index_format::Uint16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+glm::vec2 octahedral_encode(glm::vec3 n)
+{
+    auto l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    // Degenerate triangles come with zero normals; those decode as +Z.
+    if (!(l1 > 0)) {
+        return {0, 0};
+    }
+    n /= l1;
+    glm::vec2 e{n.x, n.y};
+    if (n.z < 0) {
+        e = (1.0F - glm::abs(glm::vec2{n.y, n.x})) *
+            glm::vec2{n.x >= 0 ? 1.0F : -1.0F, n.y >= 0 ? 1.0F : -1.0F};
+    }
+    return e;
+}
+
+glm::vec3 octahedral_decode(glm::vec2 e)
+{
+    glm::vec3 n{e.x, e.y, 1.0F - std::abs(e.x) - std::abs(e.y)};
+    if (n.z < 0) {
+        glm::vec2 folded = (1.0F - glm::abs(glm::vec2{n.y, n.x})) *
+                           glm::vec2{n.x >= 0 ? 1.0F : -1.0F,
+                                     n.y >= 0 ? 1.0F : -1.0F};
+        n.x = folded.x;
+        n.y = folded.y;
+    }
+    return glm::normalize(n);
+}
+
+Vertex_layout choose_vertex_layout(std::span<Vertex const> vertices)
+{
+    Vertex_layout layout{.position = Position_format::Float16,
+                         .index = Index_format::Uint16,
+                         .skinning = Skinning::None};
+    if (vertices.size() > std::numeric_limits<std::uint16_t>::max()) {
+        layout.index = Index_format::Uint32;
+    }
+    if (std::ranges::any_of(vertices, [](Vertex const &v) {
+            return v.weights != glm::vec4{};
+        })) {
+        layout.skinning = Skinning::Four_joints;
+    }
+    if (vertices.empty()) {
+        return layout;
+    }
+
+    glm::vec3 lo{std::numeric_limits<float>::max()};
+    glm::vec3 hi{std::numeric_limits<float>::lowest()};
+    for (auto const &v : vertices) {
+        lo = glm::min(lo, v.position);
+        hi = glm::max(hi, v.position);
+    }
+    float tolerance = glm::length(hi - lo) * 1e-3F;
+    constexpr float half_max{65504};
+    for (auto const &v : vertices) {
+        for (int i{}; i != 3; ++i) {
+            float p = v.position[i];
+            if (std::abs(p) > half_max ||
+                std::abs(glm::unpackHalf1x16(glm::packHalf1x16(p)) - p) >
+                    tolerance) {
+                layout.position = Position_format::Float32;
+                return layout;
+            }
+        }
+    }
+    return layout;
+}
+
+std::vector<std::byte> pack_vertices(std::span<Vertex const> vertices,
+                                     Vertex_layout layout)
+{
+    std::vector<std::byte> out;
+    out.reserve(vertices.size() * layout.stride());
+    bool skinned = layout.skinning != Skinning::None;
+    switch (layout.position) {
+    case Position_format::Float16:
+        for (auto const &v : vertices) {
+            append_bytes(out, Packed_vertex_half{
+                                  .position = {glm::packHalf1x16(v.position.x),
+                                               glm::packHalf1x16(v.position.y),
+                                               glm::packHalf1x16(v.position.z),
+                                               glm::packHalf1x16(1.0F)},
+                                  .normal = pack_normal(v.normal),
+                                  .texcoord = pack_texcoord(v.texcoord)});
+            if (skinned) {
+                append_bytes(out, pack_skin(v));
+            }
+        }
+        break;
+    case Position_format::Float32:
+        for (auto const &v : vertices) {
+            append_bytes(out,
+                         Packed_vertex_float{.position = v.position,
+                                             .normal = pack_normal(v.normal),
+                                             .texcoord =
+                                                 pack_texcoord(v.texcoord)});
+            if (skinned) {
+                append_bytes(out, pack_skin(v));
+            }
+        }
+        break;
+    }
+    return out;
+}
+
+std::vector<std::byte> pack_indices(std::span<std::uint32_t const> indices,
+                                    Index_format format)
+{
+    std::vector<std::byte> out;
+    switch (format) {
+    case Index_format::Uint16:
+        out.reserve(indices.size() * sizeof(std::uint16_t));
+        for (auto i : indices) {
+            assert(i <= std::numeric_limits<std::uint16_t>::max());
+            append_bytes(out, static_cast<std::uint16_t>(i));
+        }
+        break;
+    case Index_format::Uint32:
+        out.resize(indices.size_bytes());
+        std::memcpy(out.data(), indices.data(), indices.size_bytes());
+        break;
+    }
+    return out;
+}
+
+void setup_vertex_attributes(GLuint vao, Vertex_layout layout)
+{
+    constexpr GLuint binding{0};
+    GLuint skin_offset{};
+    switch (layout.position) {
+    case Position_format::Float16:
+        glVertexArrayAttribFormat(vao, 0, 3, GL_HALF_FLOAT, GL_FALSE,
+                                  offsetof(Packed_vertex_half, position));
+        glVertexArrayAttribFormat(vao, 1, 2, GL_SHORT, GL_TRUE,
+                                  offsetof(Packed_vertex_half, normal));
+        glVertexArrayAttribFormat(vao, 2, 2, GL_HALF_FLOAT, GL_FALSE,
+                                  offsetof(Packed_vertex_half, texcoord));
+        skin_offset = sizeof(Packed_vertex_half);
+        break;
+    case Position_format::Float32:
+        glVertexArrayAttribFormat(vao, 0, 3, GL_FLOAT, GL_FALSE,
+                                  offsetof(Packed_vertex_float, position));
+        glVertexArrayAttribFormat(vao, 1, 2, GL_SHORT, GL_TRUE,
+                                  offsetof(Packed_vertex_float, normal));
+        glVertexArrayAttribFormat(vao, 2, 2, GL_HALF_FLOAT, GL_FALSE,
+                                  offsetof(Packed_vertex_float, texcoord));
+        skin_offset = sizeof(Packed_vertex_float);
+        break;
+    }
+    GLuint attribs{3};
+    if (layout.skinning == Skinning::Four_joints) {
+        glVertexArrayAttribIFormat(vao, 3, 4, GL_UNSIGNED_SHORT,
+                                   skin_offset + offsetof(Packed_skin, joints));
+        glVertexArrayAttribFormat(vao, 4, 4, GL_UNSIGNED_BYTE, GL_TRUE,
+                                  skin_offset + offsetof(Packed_skin, weights));
+        attribs = 5;
+    }
+    for (GLuint attrib{}; attrib != attribs; ++attrib) {
+        glVertexArrayAttribBinding(vao, attrib, binding);
+        glEnableVertexArrayAttrib(vao, attrib);
+    }
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include <span>
+#include <vector>
+
+// Full precision vertex used while building or importing meshes. It is never
+// uploaded as is: Mesh packs it into one of the compact layouts below.
+struct Vertex {
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 texcoord;
+    // Skinning influences; all-zero weights mean the vertex isn't skinned.
+    std::array<std::uint16_t, 4> joints{};
+    glm::vec4 weights{};
+};
+
+enum class Position_format : std::uint8_t { Float32, Float16 };
+
+enum class Index_format : std::uint8_t { Uint16, Uint32 };
+
+enum class Skinning : std::uint8_t { None, Four_joints };
+
+// Normals are always octahedral-encoded into two snorm16 and texcoords are
+// always half floats; only positions, indices and the presence of skinning
+// data vary with the mesh.
+struct Vertex_layout {
+    Position_format position;
+    Index_format index;
+    Skinning skinning;
+
+    bool operator==(Vertex_layout const &) const = default;
+
+    [[nodiscard]] GLsizei stride() const;
+    [[nodiscard]] std::size_t index_size() const;
+    [[nodiscard]] GLenum index_type() const;
+};
+
+// 16 bytes. The fourth position component only pads to alignment.
+struct Packed_vertex_half {
+    std::array<std::uint16_t, 4> position;
+    std::array<std::int16_t, 2> normal;
+    std::array<std::uint16_t, 2> texcoord;
+};
+static_assert(sizeof(Packed_vertex_half) == 16);
+
+// 20 bytes, for meshes whose extent would lose too much precision in halves.
+struct Packed_vertex_float {
+    glm::vec3 position;
+    std::array<std::int16_t, 2> normal;
+    std::array<std::uint16_t, 2> texcoord;
+};
+static_assert(sizeof(Packed_vertex_float) == 20);
+
+// Appended to either of the above in skinned layouts. Weights are unorm8 and
+// sum to 255.
+struct Packed_skin {
+    std::array<std::uint16_t, 4> joints;
+    std::array<std::uint8_t, 4> weights;
+};
+static_assert(sizeof(Packed_skin) == 12);
+
+glm::vec2 octahedral_encode(glm::vec3 n);
+glm::vec3 octahedral_decode(glm::vec2 e);
+
+// Half positions are chosen only when the round trip error stays below a
+// thousandth of the mesh's bounding box diagonal; 16-bit indices whenever the
+// vertex count fits; skinning whenever any vertex has a weight.
+Vertex_layout choose_vertex_layout(std::span<Vertex const> vertices);
+
+std::vector<std::byte> pack_vertices(std::span<Vertex const> vertices,
+                                     Vertex_layout layout);
+std::vector<std::byte> pack_indices(std::span<std::uint32_t const> indices,
+                                    Index_format format);
+
+// Describes `layout` to `vao`. Attributes read from vertex buffer binding 0,
+// which the caller attaches with glVertexArrayVertexBuffer. Skinned layouts
+// add joints at location 3 and weights at location 4.
+void setup_vertex_attributes(GLuint vao, Vertex_layout layout);
@@ -1,22 +1,60 @@
 #version 460 core
 layout(location = 0) in vec3 aPos;
-layout(location = 1) in vec3 aNormal;
+layout(location = 1) in vec2 aNormal; // Octahedral-encoded
 layout(location = 2) in vec2 aTexCoord;
+layout(location = 3) in uvec4 aJoints;  // Skinned layouts only
+layout(location = 4) in vec4 aWeights;  // Skinned layouts only
 out vec3 LocalPos;
 out vec3 FragPos;
 out vec3 FragNormal;
 out vec2 TexCoord;
 
-uniform mat3 transposed_inverse_model;
-uniform mat4 model;
+struct Draw {
+    mat4 model;
+    mat3 transposed_inverse_model;
+    int bone_offset; // -1 if not skinned
+};
+
+// Filled by Render_queue, one entry per draw of a multi-draw.
+layout(std430, binding = 0) readonly buffer Draws {
+    Draw draws[];
+};
+
+// Skinning palettes of this frame, indexed by bone_offset + joint.
+layout(std430, binding = 1) readonly buffer Bones {
+    mat4 bones[];
+};
+
 uniform mat4 view;
 uniform mat4 projection;
 
+vec3 octahedral_decode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0) {
+        vec2 signs = vec2(n.x >= 0 ? 1.0 : -1.0, n.y >= 0 ? 1.0 : -1.0);
+        n.xy = (1.0 - abs(n.yx)) * signs;
+    }
+    return normalize(n);
+}
+
 void main() {
-    vec4 clipPos = projection * view * model * vec4(aPos, 1.0);
+    Draw draw = draws[gl_BaseInstance];
+    vec4 pos = vec4(aPos, 1.0);
+    vec3 normal = octahedral_decode(aNormal);
+    if (draw.bone_offset >= 0) {
+        int b = draw.bone_offset;
+        mat4 skin = aWeights.x * bones[b + int(aJoints.x)] +
+                    aWeights.y * bones[b + int(aJoints.y)] +
+                    aWeights.z * bones[b + int(aJoints.z)] +
+                    aWeights.w * bones[b + int(aJoints.w)];
+        pos = skin * pos;
+        // Bones carry no non-uniform scale, so mat3(skin) is fine for normals.
+        normal = normalize(mat3(skin) * normal);
+    }
+    vec4 clipPos = projection * view * draw.model * pos;
     gl_Position = clipPos;
-    LocalPos = aPos;
-    FragPos = vec3(model * vec4(aPos, 1)); // World pos
-    FragNormal = transposed_inverse_model * aNormal;
+    LocalPos = pos.xyz;
+    FragPos = vec3(draw.model * pos); // World pos
+    FragNormal = draw.transposed_inverse_model * normal;
     TexCoord = aTexCoord;
 }
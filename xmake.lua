@@ -15,6 +15,7 @@ add_requires("glm")
 add_requires("imgui", { configs = { glfw = true, opengl3 = true, } })
 add_requires("spdlog")
 add_requires("stb")
+add_requires("zlib")
 
 add_cxxflags("-Wmissing-field-initializers")
 
@@ -23,5 +24,5 @@ target("mountblade-clone")
     add_files("mb/*.cpp")
     add_headerfiles("mb/*.h")
     add_deps("glad")
-    add_packages("assimp", "entt", "freetype", "glfw", "glm", "imgui", "spdlog", "stb")
+    add_packages("assimp", "entt", "freetype", "glfw", "glm", "imgui", "spdlog", "stb", "zlib")
     add_includedirs("$(projectdir)")